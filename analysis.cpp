@@ -0,0 +1,252 @@
+// Primary Include
+#include "analysis.hpp"
+
+// Standard Includes
+#include <algorithm>
+
+// Backwards dataflow over the blocks in layout: in = use + (out - def), out = union of successor ins
+analysis::Liveness analysis::computeLiveness(const ir::Function& func)
+{
+  int blocks = func.getBlockCount();
+  int vregs = func.getVRegCount();
+  Liveness live;
+  live.in.assign(blocks, std::vector<bool>(vregs, false));
+  live.out.assign(blocks, std::vector<bool>(vregs, false));
+
+  std::vector<std::vector<bool>> uses(blocks, std::vector<bool>(vregs, false));
+  std::vector<std::vector<bool>> defs(blocks, std::vector<bool>(vregs, false));
+  for (auto&& id : func.getLayout())
+  {
+    for (auto&& instr : func.getBlock(id).instrs)
+    {
+      for (auto&& src : instr.src)
+      {
+        if (src.isReg() && !defs[id][src.value])
+          uses[id][src.value] = true;
+      }
+      if (instr.dst >= 0)
+        defs[id][instr.dst] = true;
+    }
+  }
+
+  const auto& layout = func.getLayout();
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (auto it = layout.rbegin(); it != layout.rend(); ++it)
+    {
+      int id = *it;
+      std::vector<bool> out(vregs, false);
+      for (auto&& succ : ir::getSuccessors(func.getBlock(id)))
+      {
+        for (int v = 0; v < vregs; ++v)
+        {
+          if (live.in[succ][v])
+            out[v] = true;
+        }
+      }
+
+      std::vector<bool> in(vregs, false);
+      for (int v = 0; v < vregs; ++v)
+        in[v] = uses[id][v] || (out[v] && !defs[id][v]);
+
+      if (in != live.in[id] || out != live.out[id])
+      {
+        live.in[id] = std::move(in);
+        live.out[id] = std::move(out);
+        changed = true;
+      }
+    }
+  }
+  return live;
+}
+
+std::vector<bool> analysis::findReachable(const ir::Function& func)
+{
+  std::vector<bool> reached(func.getBlockCount(), false);
+  if (func.getLayout().empty())
+    return reached;
+
+  std::vector<int> work = { func.getLayout().front() };
+  reached[work.back()] = true;
+  while (!work.empty())
+  {
+    int id = work.back();
+    work.pop_back();
+    for (auto&& succ : ir::getSuccessors(func.getBlock(id)))
+    {
+      if (!reached[succ])
+      {
+        reached[succ] = true;
+        work.push_back(succ);
+      }
+    }
+  }
+  return reached;
+}
+
+namespace
+{
+  // Reverse postorder of the blocks reachable from the entry
+  std::vector<int> getReversePostorder(const ir::Function& func)
+  {
+    std::vector<int> order;
+    std::vector<bool> seen(func.getBlockCount(), false);
+    std::vector<std::pair<int, std::size_t>> stack = { { func.getLayout().front(), 0 } };
+    seen[func.getLayout().front()] = true;
+    while (!stack.empty())
+    {
+      auto& top = stack.back();
+      auto succs = ir::getSuccessors(func.getBlock(top.first));
+      if (top.second < succs.size())
+      {
+        int succ = succs[top.second++];
+        if (!seen[succ])
+        {
+          seen[succ] = true;
+          stack.push_back({ succ, 0 });
+        }
+      }
+      else
+      {
+        order.push_back(top.first);
+        stack.pop_back();
+      }
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+  }
+}
+
+// Cooper, Harvey and Kennedy's iterative algorithm over the reverse postorder
+std::vector<int> analysis::computeDominators(const ir::Function& func)
+{
+  std::vector<int> idom(func.getBlockCount(), -1);
+  if (func.getLayout().empty())
+    return idom;
+
+  auto order = getReversePostorder(func);
+  std::vector<int> index(func.getBlockCount(), -1);
+  for (int i = 0; i < static_cast<int>(order.size()); ++i)
+    index[order[i]] = i;
+
+  auto preds = ir::getPredecessors(func);
+  int entry = order.front();
+  idom[entry] = entry;
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (auto it = order.begin() + 1; it != order.end(); ++it)
+    {
+      int dom = -1;
+      for (auto&& pred : preds[*it])
+      {
+        if (idom[pred] < 0)
+          continue;
+        if (dom < 0)
+        {
+          dom = pred;
+          continue;
+        }
+
+        int other = pred;
+        while (dom != other)
+        {
+          while (index[dom] > index[other])
+            dom = idom[dom];
+          while (index[other] > index[dom])
+            other = idom[other];
+        }
+      }
+      if (dom != idom[*it])
+      {
+        idom[*it] = dom;
+        changed = true;
+      }
+    }
+  }
+  return idom;
+}
+
+bool analysis::dominates(const std::vector<int>& idom, int dom, int id)
+{
+  while (idom[id] >= 0 && id != dom)
+  {
+    if (idom[id] == id)
+      return false;
+    id = idom[id];
+  }
+  return id == dom;
+}
+
+// A back edge goes to a block dominating its source, the loop is every block
+// that reaches the source without passing through the header
+std::vector<analysis::Loop> analysis::findLoops(const ir::Function& func)
+{
+  auto idom = computeDominators(func);
+  auto preds = ir::getPredecessors(func);
+  std::vector<Loop> loops;
+  for (auto&& id : func.getLayout())
+  {
+    if (idom[id] < 0)
+      continue;
+    for (auto&& header : ir::getSuccessors(func.getBlock(id)))
+    {
+      if (!dominates(idom, header, id))
+        continue;
+
+      auto found = std::find_if(loops.begin(), loops.end(), [&](const Loop& loop)
+      {
+        return loop.header == header;
+      });
+      if (found == loops.end())
+      {
+        loops.push_back({ header, std::vector<bool>(func.getBlockCount(), false) });
+        found = loops.end() - 1;
+        found->blocks[header] = true;
+      }
+
+      std::vector<int> work = { id };
+      while (!work.empty())
+      {
+        int block = work.back();
+        work.pop_back();
+        if (found->blocks[block])
+          continue;
+        found->blocks[block] = true;
+        for (auto&& pred : preds[block])
+          work.push_back(pred);
+      }
+    }
+  }
+  return loops;
+}
+
+// A block is in the frontier of every block on the paths from its
+// predecessors up to, but excluding, its immediate dominator
+std::vector<std::vector<int>> analysis::computeFrontiers(const ir::Function& func, const std::vector<int>& idom)
+{
+  std::vector<std::vector<int>> frontiers(func.getBlockCount());
+  auto preds = ir::getPredecessors(func);
+  for (auto&& id : func.getLayout())
+  {
+    if (idom[id] < 0 || preds[id].size() < 2)
+      continue;
+    for (auto&& pred : preds[id])
+    {
+      int runner = pred;
+      while (idom[runner] >= 0 && runner != idom[id])
+      {
+        auto& frontier = frontiers[runner];
+        if (std::find(frontier.begin(), frontier.end(), id) == frontier.end())
+          frontier.push_back(id);
+        if (idom[runner] == runner)
+          break;
+        runner = idom[runner];
+      }
+    }
+  }
+  return frontiers;
+}
@@ -0,0 +1,41 @@
+#ifndef CS5300_ANALYSIS_HPP
+#define CS5300_ANALYSIS_HPP
+
+// Project Includes
+#include "ir.hpp"
+
+// Standard Includes
+#include <vector>
+
+namespace analysis
+{
+  // Virtual registers live on entry to and exit from each block, indexed by block id
+  struct Liveness
+  {
+    std::vector<std::vector<bool>> in;
+    std::vector<std::vector<bool>> out;
+  };
+
+  Liveness computeLiveness(const ir::Function& func);
+
+  // Blocks reachable from the entry block, indexed by block id
+  std::vector<bool> findReachable(const ir::Function& func);
+
+  // Immediate dominator of each block indexed by block id, the entry is its own and unreachable blocks have -1
+  std::vector<int> computeDominators(const ir::Function& func);
+  bool dominates(const std::vector<int>& idom, int dom, int id);
+
+  // Dominance frontier of each block, where the definitions made in it meet other paths
+  std::vector<std::vector<int>> computeFrontiers(const ir::Function& func, const std::vector<int>& idom);
+
+  // Natural loop of a header, the blocks of every back edge to it merged
+  struct Loop
+  {
+    int header;
+    std::vector<bool> blocks; // Indexed by block id
+  };
+
+  std::vector<Loop> findLoops(const ir::Function& func);
+}
+
+#endif
@@ -0,0 +1,152 @@
+// Primary Include
+#include "passes.hpp"
+
+// Project Includes
+#include "analysis.hpp"
+#include "ir.hpp"
+
+// Standard Includes
+#include <algorithm>
+
+// Replaces branches whose outcome is known at compile time with jumps and
+// drops the blocks no longer reachable from the entry, such as the arms of
+// an if on a constant flag, the body of while false and code after stop.
+void passes::foldBranches(ir::Function& func)
+{
+  for (auto&& id : func.getLayout())
+  {
+    auto& instrs = func.getBlock(id).instrs;
+    if (instrs.empty() || instrs.back().op != ir::IR_BRANCH)
+      continue;
+
+    auto& term = instrs.back();
+    int target = -1;
+    if (term.target[0] == term.target[1])
+      target = term.target[0];
+    else if (term.src[0].isConst() && term.src[1].isConst())
+      target = ir::evaluate(term.cond, term.src[0].value, term.src[1].value) ? term.target[0] : term.target[1];
+    else if (term.src[0] == term.src[1])
+      target = ir::evaluate(term.cond, 0, 0) ? term.target[0] : term.target[1];
+
+    if (target >= 0)
+    {
+      int comment = term.comment;
+      term = ir::jump(target);
+      term.comment = comment;
+      count("fold-branches.branches");
+    }
+  }
+
+  auto reached = analysis::findReachable(func);
+  auto& layout = func.getLayout();
+  auto end = std::remove_if(layout.begin(), layout.end(), [&](int id)
+  {
+    return !reached[id];
+  });
+  count("fold-branches.unreachable", static_cast<int>(layout.end() - end));
+  layout.erase(end, layout.end());
+}
+
+namespace
+{
+  // Follows jumps through blocks that contain nothing but a jump, stopping at loops of such blocks
+  int findFinalTarget(const ir::Function& func, int id)
+  {
+    std::vector<bool> seen(func.getBlockCount(), false);
+    while (!seen[id])
+    {
+      seen[id] = true;
+      const auto& instrs = func.getBlock(id).instrs;
+      if (instrs.size() != 1 || instrs.back().op != ir::IR_JUMP)
+        break;
+      id = instrs.back().target[0];
+    }
+    return id;
+  }
+
+  bool threadJumps(ir::Function& func)
+  {
+    bool changed = false;
+    for (auto&& id : func.getLayout())
+    {
+      auto& instrs = func.getBlock(id).instrs;
+      if (instrs.empty())
+        continue;
+
+      auto& term = instrs.back();
+      int targets = term.op == ir::IR_BRANCH ? 2 : term.op == ir::IR_JUMP ? 1 : 0;
+      for (int i = 0; i < targets; ++i)
+      {
+        int target = findFinalTarget(func, term.target[i]);
+        if (target != term.target[i])
+        {
+          term.target[i] = target;
+          passes::count("simplify-cfg.threaded");
+          changed = true;
+        }
+      }
+
+      // Both arms meet again, the comparison is not needed
+      if (term.op == ir::IR_BRANCH && term.target[0] == term.target[1])
+      {
+        int comment = term.comment;
+        term = ir::jump(term.target[0]);
+        term.comment = comment;
+        passes::count("simplify-cfg.branches");
+        changed = true;
+      }
+    }
+    return changed;
+  }
+
+  // Appends a block to the block jumping to it when it has no other predecessor
+  bool mergeBlocks(ir::Function& func)
+  {
+    auto preds = ir::getPredecessors(func);
+    auto& layout = func.getLayout();
+    int entry = layout.front();
+    for (auto&& id : layout)
+    {
+      auto& instrs = func.getBlock(id).instrs;
+      if (instrs.empty() || instrs.back().op != ir::IR_JUMP)
+        continue;
+
+      int succ = instrs.back().target[0];
+      if (succ == id || succ == entry || preds[succ].size() != 1)
+        continue;
+
+      auto& merged = func.getBlock(succ).instrs;
+      instrs.pop_back();
+      instrs.insert(instrs.end(), merged.begin(), merged.end());
+      merged.clear();
+      layout.erase(std::find(layout.begin(), layout.end(), succ));
+      passes::count("simplify-cfg.merged");
+      return true;
+    }
+    return false;
+  }
+}
+
+// Cleans up the control flow left by nested if/elseif chains: jumps to
+// blocks that only jump again go straight to the final target, blocks
+// reached by a single jump are merged into their predecessor and blocks
+// left without predecessors are dropped. Lowering omits the remaining
+// jumps to the block that follows in the layout.
+void passes::simplifyCfg(ir::Function& func)
+{
+  bool changed = true;
+  while (changed)
+  {
+    changed = threadJumps(func);
+    while (mergeBlocks(func))
+      changed = true;
+  }
+
+  auto reached = analysis::findReachable(func);
+  auto& layout = func.getLayout();
+  auto end = std::remove_if(layout.begin(), layout.end(), [&](int id)
+  {
+    return !reached[id];
+  });
+  layout.erase(end, layout.end());
+}
@@ -0,0 +1,799 @@
+// Primary Include
+#include "codegen.hpp"
+
+// Project Includes
+#include "passes.hpp"
+#include "regalloc.hpp"
+#include "tables.hpp"
+
+// Standard Includes
+#include <algorithm>
+#include <climits>
+#include <set>
+
+namespace
+{
+  const int SYSCALL_EXIT = 10;
+
+  // Arguments passed in $a0-$a3, the rest on the stack
+  const int ARG_REGS = 4;
+
+  // Cycles charged for li, mult and mflo including the wait for the product,
+  // a shift and add sequence is used when it takes fewer instructions
+  const int MULT_COST = 8;
+
+  bool isImm16(int value)
+  {
+    return value >= -32768 && value <= 32767;
+  }
+
+  bool isUImm16(int value)
+  {
+    return value >= 0 && value <= 65535;
+  }
+
+  // Non-adjacent form of value, least significant digit first, each digit -1, 0 or 1
+  std::vector<int> getSignedDigits(long long value)
+  {
+    std::vector<int> digits;
+    while (value != 0)
+    {
+      int digit = 0;
+      if (value & 1)
+      {
+        digit = 2 - static_cast<int>(value & 3);
+        value -= digit;
+      }
+      digits.push_back(digit);
+      value /= 2;
+    }
+    return digits;
+  }
+
+  // Multiplies src by a constant into dst with shifts and adds following the
+  // signed digits from the top (Horner's rule), building partial products in
+  // acc. The wrapping addu/subu match what mult produces on overflow.
+  std::vector<mips::MachineInstr> getShiftAdd(int dst, int src, int acc, int value)
+  {
+    std::vector<mips::MachineInstr> seq;
+    if (value == 0 || value == 1)
+    {
+      seq.push_back(mips::move(dst, value == 0 ? mips::REG_ZERO : src));
+      return seq;
+    }
+
+    auto digits = getSignedDigits(value);
+    int cur = src;
+    if (digits.back() < 0)
+    {
+      seq.push_back(mips::arith(mips::OP_SUBU, acc, mips::REG_ZERO, src));
+      cur = acc;
+    }
+
+    int shift = 0;
+    for (int i = static_cast<int>(digits.size()) - 2; i >= 0; --i)
+    {
+      ++shift;
+      if (digits[i] == 0)
+        continue;
+      seq.push_back(mips::arithImm(mips::OP_SLL, acc, cur, shift));
+      seq.push_back(mips::arith(digits[i] > 0 ? mips::OP_ADDU : mips::OP_SUBU, acc, acc, src));
+      cur = acc;
+      shift = 0;
+    }
+    if (shift > 0)
+      seq.push_back(mips::arithImm(mips::OP_SLL, acc, cur, shift));
+    seq.back().rd = dst;
+    return seq;
+  }
+
+  bool isShiftAddCheaper(int value)
+  {
+    return static_cast<int>(getShiftAdd(mips::REG_T0, mips::REG_T1, mips::REG_T0, value).size()) < MULT_COST;
+  }
+
+  // Multiplier and shift for signed division by a constant outside [-1, 1], see Hacker's Delight 10-1
+  void getMagic(int divisor, int& magic, int& shift)
+  {
+    const unsigned two31 = 0x80000000u;
+    unsigned ad = divisor < 0 ? 0u - static_cast<unsigned>(divisor) : static_cast<unsigned>(divisor);
+    unsigned t = two31 + (static_cast<unsigned>(divisor) >> 31);
+    unsigned anc = t - 1 - t % ad;
+    int p = 31;
+    unsigned q1 = two31 / anc;
+    unsigned r1 = two31 - q1 * anc;
+    unsigned q2 = two31 / ad;
+    unsigned r2 = two31 - q2 * ad;
+    unsigned delta;
+    do
+    {
+      ++p;
+      q1 *= 2;
+      r1 *= 2;
+      if (r1 >= anc)
+      {
+        ++q1;
+        r1 -= anc;
+      }
+      q2 *= 2;
+      r2 *= 2;
+      if (r2 >= ad)
+      {
+        ++q2;
+        r2 -= ad;
+      }
+      delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    magic = static_cast<int>(q2 + 1);
+    if (divisor < 0)
+      magic = -magic;
+    shift = p - 32;
+  }
+
+  // Exponent of a power of two magnitude, 0 otherwise
+  int getLog2(int value)
+  {
+    unsigned magnitude = value < 0 ? 0u - static_cast<unsigned>(value) : static_cast<unsigned>(value);
+    if (magnitude < 2 || (magnitude & (magnitude - 1)) != 0)
+      return 0;
+    int log = 0;
+    while (magnitude >>= 1)
+      ++log;
+    return log;
+  }
+
+  // Compare-and-branch of a register against zero
+  mips::MachineInstr getBranchZero(ir::Cond cond, int reg, int label)
+  {
+    switch (cond)
+    {
+    case ir::COND_EQ: return mips::branch(mips::OP_BEQ, reg, mips::REG_ZERO, label);
+    case ir::COND_NE: return mips::branch(mips::OP_BNE, reg, mips::REG_ZERO, label);
+    case ir::COND_LT: return mips::branchZero(mips::OP_BLTZ, reg, label);
+    case ir::COND_LE: return mips::branchZero(mips::OP_BLEZ, reg, label);
+    case ir::COND_GT: return mips::branchZero(mips::OP_BGTZ, reg, label);
+    default: return mips::branchZero(mips::OP_BGEZ, reg, label);
+    }
+  }
+
+  mips::Opcode getMipsOp(ir::Opcode op)
+  {
+    switch (op)
+    {
+    case ir::IR_ADD: return mips::OP_ADD;
+    case ir::IR_SUB: return mips::OP_SUB;
+    case ir::IR_AND: return mips::OP_AND;
+    case ir::IR_OR: return mips::OP_OR;
+    case ir::IR_XOR: return mips::OP_XOR;
+    case ir::IR_SEQ: return mips::OP_SEQ;
+    case ir::IR_SNE: return mips::OP_SNE;
+    case ir::IR_SLT: return mips::OP_SLT;
+    case ir::IR_SLE: return mips::OP_SLE;
+    case ir::IR_SGT: return mips::OP_SGT;
+    default: return mips::OP_SGE;
+    }
+  }
+
+  // Translates one IR function into machine instructions using the register
+  // assignment from regalloc. Spilled values live in a stack frame set up on
+  // entry and go through the scratch registers.
+  class Lowering
+  {
+  public:
+    Lowering(const ir::Function& func, mips::Function& out)
+      : m_func(func), m_out(out), m_alloc(regalloc::allocate(func)),
+        m_mulConst(passes::isEnabled("mul-const")), m_divConst(passes::isEnabled("div-const")),
+        m_immSelect(passes::isEnabled("imm-select")) {}
+
+    void run()
+    {
+      m_start = m_out.getCode().size();
+      findLabels();
+      buildFrame();
+
+      if (m_frameSize > 0)
+        emit(mips::arithImm(mips::OP_ADDI, mips::REG_SP, mips::REG_SP, -m_frameSize));
+      for (auto&& saved : m_saved)
+        emit(mips::store(saved.first, saved.second, mips::REG_SP));
+
+      const auto& layout = m_func.getLayout();
+      for (m_pos = 0; m_pos < static_cast<int>(layout.size()); ++m_pos)
+      {
+        const auto& block = m_func.getBlock(layout[m_pos]);
+        if (m_labels.count(block.id))
+          m_out.emit(mips::label(getLabel(block.id)));
+
+        for (auto&& instr : block.instrs)
+          lowerInstr(instr);
+      }
+
+      removeUnusedLabels();
+    }
+
+  private:
+    // From $sp up: stack arguments of the calls made, spill slots, then the
+    // registers a function that returns must preserve for its caller. Only
+    // the $s registers it was allocated are saved, and $ra only when it calls.
+    void buildFrame()
+    {
+      bool returns = false;
+      bool calls = false;
+      int stackArgs = 0;
+      for (auto&& id : m_func.getLayout())
+      {
+        for (auto&& instr : m_func.getBlock(id).instrs)
+        {
+          returns = returns || instr.op == ir::IR_RETURN;
+          calls = calls || instr.op == ir::IR_CALL;
+          if (instr.op == ir::IR_ARG)
+            stackArgs = std::max(stackArgs, instr.imm - ARG_REGS + 1);
+        }
+      }
+
+      m_spillBase = 4 * stackArgs;
+      m_frameSize = m_spillBase + m_alloc.frameSize;
+      if (!returns)
+        return;
+
+      std::set<int> used;
+      for (auto&& reg : m_alloc.regs)
+      {
+        if (reg >= mips::REG_S0 && reg <= mips::REG_S7)
+          used.insert(reg);
+      }
+      if (calls)
+        used.insert(mips::REG_RA);
+      for (auto&& reg : used)
+      {
+        m_saved.push_back({ reg, m_frameSize });
+        m_frameSize += 4;
+      }
+    }
+
+    void findLabels()
+    {
+      for (auto&& id : m_func.getLayout())
+      {
+        for (auto&& succ : ir::getSuccessors(m_func.getBlock(id)))
+          m_labels.insert(succ);
+      }
+    }
+
+    // Blocks reached only by falling through do not need a label in the listing
+    void removeUnusedLabels()
+    {
+      std::set<int> used = m_tableLabels;
+      auto& code = m_out.getCode();
+      for (auto&& instr : code)
+      {
+        if (instr.op != mips::OP_LABEL && instr.label >= 0)
+          used.insert(instr.label);
+      }
+
+      code.erase(std::remove_if(code.begin() + m_start, code.end(), [&](const mips::MachineInstr& instr)
+      {
+        return instr.op == mips::OP_LABEL && !used.count(instr.label);
+      }), code.end());
+    }
+
+    int getLabel(int block) const
+    {
+      return mips::addLabel(m_func.getBlock(block).name);
+    }
+
+    int getNextBlock() const
+    {
+      const auto& layout = m_func.getLayout();
+      return m_pos + 1 < static_cast<int>(layout.size()) ? layout[m_pos + 1] : -1;
+    }
+
+    void emit(mips::MachineInstr instr, int comment = -1)
+    {
+      instr.comment = comment;
+      m_out.emit(instr);
+    }
+
+    // Constants outside the 16 bit immediate ranges are built from their upper and lower halves
+    void loadConst(int reg, int value, int comment = -1)
+    {
+      if (!m_immSelect || isImm16(value) || isUImm16(value))
+      {
+        emit(mips::loadImm(mips::OP_LI, reg, value), comment);
+        return;
+      }
+
+      unsigned bits = static_cast<unsigned>(value);
+      emit(mips::loadImm(mips::OP_LUI, reg, static_cast<int>(bits >> 16)), (bits & 0xffff) ? -1 : comment);
+      if (bits & 0xffff)
+        emit(mips::arithImm(mips::OP_ORI, reg, reg, static_cast<int>(bits & 0xffff)), comment);
+    }
+
+    // Materializes an operand in a physical register: $zero for 0, otherwise
+    // the given scratch register for constants and spilled values
+    int use(const ir::Operand& operand, int scratch)
+    {
+      if (operand.isReg())
+      {
+        int reg = m_alloc.regs[operand.value];
+        if (reg != mips::REG_NONE)
+          return reg;
+        emit(mips::load(scratch, m_spillBase + m_alloc.slots[operand.value], mips::REG_SP));
+        return scratch;
+      }
+      if (operand.value == 0)
+        return mips::REG_ZERO;
+
+      loadConst(scratch, operand.value);
+      return scratch;
+    }
+
+    // Register the result of an instruction is computed into, stored back by spill() when it has no register
+    int def(int vreg) const
+    {
+      int reg = m_alloc.regs[vreg];
+      return reg != mips::REG_NONE ? reg : regalloc::SCRATCH0;
+    }
+
+    void spill(int vreg, int reg = regalloc::SCRATCH0)
+    {
+      if (m_alloc.regs[vreg] == mips::REG_NONE)
+        emit(mips::store(reg, m_spillBase + m_alloc.slots[vreg], mips::REG_SP));
+    }
+
+    void lowerMulConst(int dst, int src, int value, int comment)
+    {
+      // Keep the partial product out of the source register until the last step
+      for (auto&& instr : getShiftAdd(dst, src, dst != src ? dst : regalloc::SCRATCH1, value))
+        emit(instr);
+      m_out.getCode().back().comment = comment;
+      passes::count("mul-const");
+    }
+
+    // Signed division and remainder by a nonzero constant without div. Both
+    // truncate toward zero like div: a power of two is biased by 2^k - 1 for
+    // negative dividends before shifting, other divisors multiply by a magic
+    // number and keep the high word. The remainder is src - quotient * divisor.
+    void lowerDivConst(ir::Opcode op, int dst, int src, int divisor, int comment)
+    {
+      const int acc = regalloc::SCRATCH1;
+      const int tmp = regalloc::SCRATCH2;
+      bool quotient = op == ir::IR_DIV;
+      int log = getLog2(divisor);
+
+      if (divisor == 1 || divisor == -1)
+      {
+        if (!quotient)
+          emit(mips::move(dst, mips::REG_ZERO), comment);
+        else if (divisor == 1)
+          emit(mips::move(dst, src), comment);
+        else
+          emit(mips::arith(mips::OP_SUBU, dst, mips::REG_ZERO, src), comment);
+      }
+      else if (log > 0)
+      {
+        if (log == 1)
+          emit(mips::arithImm(mips::OP_SRL, acc, src, 31));
+        else
+        {
+          emit(mips::arithImm(mips::OP_SRA, acc, src, 31));
+          emit(mips::arithImm(mips::OP_SRL, acc, acc, 32 - log));
+        }
+        emit(mips::arith(mips::OP_ADDU, acc, acc, src));
+        if (quotient && divisor > 0)
+          emit(mips::arithImm(mips::OP_SRA, dst, acc, log), comment);
+        else if (quotient)
+        {
+          emit(mips::arithImm(mips::OP_SRA, acc, acc, log));
+          emit(mips::arith(mips::OP_SUBU, dst, mips::REG_ZERO, acc), comment);
+        }
+        else
+        {
+          emit(mips::arithImm(mips::OP_SRA, acc, acc, log));
+          emit(mips::arithImm(mips::OP_SLL, acc, acc, log));
+          emit(mips::arith(mips::OP_SUBU, dst, src, acc), comment);
+        }
+      }
+      else
+      {
+        int magic;
+        int shift;
+        getMagic(divisor, magic, shift);
+        loadConst(acc, magic);
+        emit(mips::multDiv(mips::OP_MULT, src, acc));
+        emit(mips::hiLo(mips::OP_MFHI, acc));
+        if (divisor > 0 && magic < 0)
+          emit(mips::arith(mips::OP_ADDU, acc, acc, src));
+        else if (divisor < 0 && magic > 0)
+          emit(mips::arith(mips::OP_SUBU, acc, acc, src));
+        if (shift > 0)
+          emit(mips::arithImm(mips::OP_SRA, acc, acc, shift));
+        emit(mips::arithImm(mips::OP_SRL, tmp, acc, 31));
+        if (quotient)
+          emit(mips::arith(mips::OP_ADDU, dst, acc, tmp), comment);
+        else
+        {
+          emit(mips::arith(mips::OP_ADDU, acc, acc, tmp));
+          if (isShiftAddCheaper(divisor))
+          {
+            for (auto&& instr : getShiftAdd(tmp, acc, tmp, divisor))
+              emit(instr);
+          }
+          else
+          {
+            loadConst(tmp, divisor);
+            emit(mips::multDiv(mips::OP_MULT, acc, tmp));
+            emit(mips::hiLo(mips::OP_MFLO, tmp));
+          }
+          emit(mips::arith(mips::OP_SUBU, dst, src, tmp), comment);
+        }
+      }
+      passes::count("div-const");
+    }
+
+    // Selects the immediate form of a binary operation with a constant right
+    // operand, returns false when there is none and the constant needs a register
+    bool lowerImmediate(ir::Opcode op, int dst, const ir::Operand& lhs, int value, int comment)
+    {
+      bool fits = isImm16(value);
+      bool fitsNext = value != INT_MAX && isImm16(value + 1);
+      switch (op)
+      {
+      case ir::IR_ADD:
+        if (!fits)
+          return false;
+        emit(mips::arithImm(mips::OP_ADDI, dst, use(lhs, regalloc::SCRATCH0), value), comment);
+        return true;
+      case ir::IR_XOR:
+        if (!isUImm16(value))
+          return false;
+        emit(mips::arithImm(mips::OP_XORI, dst, use(lhs, regalloc::SCRATCH0), value), comment);
+        return true;
+      default:
+        break;
+      }
+      if (!m_immSelect)
+        return false;
+
+      switch (op)
+      {
+      case ir::IR_SUB:
+        if (value == INT_MIN || !isImm16(-value))
+          return false;
+        emit(mips::arithImm(mips::OP_ADDI, dst, use(lhs, regalloc::SCRATCH0), -value), comment);
+        return true;
+      case ir::IR_AND:
+      case ir::IR_OR:
+        if (!isUImm16(value))
+          return false;
+        emit(mips::arithImm(op == ir::IR_AND ? mips::OP_ANDI : mips::OP_ORI, dst, use(lhs, regalloc::SCRATCH0), value), comment);
+        return true;
+      case ir::IR_SLT:
+      case ir::IR_SGE:
+        // x >= c is !(x < c)
+        if (!fits)
+          return false;
+        emit(mips::arithImm(mips::OP_SLTI, dst, use(lhs, regalloc::SCRATCH0), value), op == ir::IR_SLT ? comment : -1);
+        if (op == ir::IR_SGE)
+          emit(mips::arithImm(mips::OP_XORI, dst, dst, 1), comment);
+        return true;
+      case ir::IR_SLE:
+      case ir::IR_SGT:
+        // x <= c is x < c + 1 and x > c is !(x < c + 1)
+        if (!fitsNext)
+          return false;
+        emit(mips::arithImm(mips::OP_SLTI, dst, use(lhs, regalloc::SCRATCH0), value + 1), op == ir::IR_SLE ? comment : -1);
+        if (op == ir::IR_SGT)
+          emit(mips::arithImm(mips::OP_XORI, dst, dst, 1), comment);
+        return true;
+      case ir::IR_SEQ:
+      case ir::IR_SNE:
+      {
+        // Compare the difference with zero, x ^ c is zero exactly when x == c
+        if (value != 0 && !isUImm16(value))
+          return false;
+        int diff = use(lhs, regalloc::SCRATCH0);
+        if (value != 0)
+        {
+          emit(mips::arithImm(mips::OP_XORI, regalloc::SCRATCH1, diff, value));
+          diff = regalloc::SCRATCH1;
+        }
+        if (op == ir::IR_SEQ)
+          emit(mips::arithImm(mips::OP_SLTIU, dst, diff, 1), comment);
+        else
+          emit(mips::arith(mips::OP_SLTU, dst, mips::REG_ZERO, diff), comment);
+        return true;
+      }
+      default:
+        return false;
+      }
+    }
+
+    void lowerBinary(const ir::Instr& instr)
+    {
+      auto op = instr.op;
+      auto lhs = instr.src[0];
+      auto rhs = instr.src[1];
+      if (lhs.isConst() && rhs.isReg() && (ir::isCommutative(op) || ir::getSwapped(op) != op))
+      {
+        std::swap(lhs, rhs);
+        op = ir::getSwapped(op);
+      }
+
+      int dst = def(instr.dst);
+      if (op == ir::IR_MUL && m_mulConst && lhs.isReg() && rhs.isConst() && isShiftAddCheaper(rhs.value))
+        lowerMulConst(dst, use(lhs, regalloc::SCRATCH0), rhs.value, instr.comment);
+      else if ((op == ir::IR_DIV || op == ir::IR_MOD) && m_divConst && lhs.isReg() && rhs.isConst() && rhs.value != 0)
+        lowerDivConst(op, dst, use(lhs, regalloc::SCRATCH0), rhs.value, instr.comment);
+      else if (!lhs.isReg() || !rhs.isConst() || !lowerImmediate(op, dst, lhs, rhs.value, instr.comment))
+      {
+        int src0 = use(lhs, regalloc::SCRATCH0);
+        int src1 = use(rhs, regalloc::SCRATCH1);
+        switch (op)
+        {
+        case ir::IR_MUL:
+          emit(mips::multDiv(mips::OP_MULT, src0, src1));
+          emit(mips::hiLo(mips::OP_MFLO, dst), instr.comment);
+          break;
+        case ir::IR_DIV:
+          emit(mips::multDiv(mips::OP_DIV, src0, src1));
+          emit(mips::hiLo(mips::OP_MFLO, dst), instr.comment);
+          break;
+        case ir::IR_MOD:
+          emit(mips::multDiv(mips::OP_DIV, src0, src1));
+          emit(mips::hiLo(mips::OP_MFHI, dst), instr.comment);
+          break;
+        default:
+          emit(mips::arith(getMipsOp(op), dst, src0, src1), instr.comment);
+          break;
+        }
+      }
+      spill(instr.dst);
+    }
+
+    void lowerBranch(const ir::Instr& instr)
+    {
+      auto cond = instr.cond;
+      int ifTrue = instr.target[0];
+      int ifFalse = instr.target[1];
+      int next = getNextBlock();
+
+      // Branch to whichever successor does not follow in the layout
+      if (ifTrue == next)
+      {
+        std::swap(ifTrue, ifFalse);
+        cond = ir::invert(cond);
+      }
+
+      auto lhs = instr.src[0];
+      auto rhs = instr.src[1];
+      if (lhs.isConst() && rhs.isReg())
+      {
+        std::swap(lhs, rhs);
+        cond = ir::getSwapped(cond);
+      }
+
+      // x < 1 is x <= 0 and x <= -1 is x < 0, likewise for their negations
+      if (rhs.isConst() && rhs.value == 1 && (cond == ir::COND_LT || cond == ir::COND_GE))
+      {
+        rhs.value = 0;
+        cond = cond == ir::COND_LT ? ir::COND_LE : ir::COND_GT;
+      }
+      else if (rhs.isConst() && rhs.value == -1 && (cond == ir::COND_LE || cond == ir::COND_GT))
+      {
+        rhs.value = 0;
+        cond = cond == ir::COND_LE ? ir::COND_LT : ir::COND_GE;
+      }
+
+      int target = getLabel(ifTrue);
+      if (lhs.isReg() && rhs.isConst() && rhs.value == 0)
+        emit(getBranchZero(cond, use(lhs, regalloc::SCRATCH0), target), instr.comment);
+      else if (cond == ir::COND_EQ || cond == ir::COND_NE)
+      {
+        int src0 = use(lhs, regalloc::SCRATCH0);
+        int src1 = use(rhs, regalloc::SCRATCH1);
+        emit(mips::branch(cond == ir::COND_EQ ? mips::OP_BEQ : mips::OP_BNE, src0, src1, target), instr.comment);
+      }
+      else
+      {
+        // Every ordering reduces to a set-less-than and a branch on it: x <= c is x < c + 1, and
+        // >= and > are the negations of < and <=
+        bool taken = cond == ir::COND_LT || cond == ir::COND_LE;
+        if (cond == ir::COND_LE || cond == ir::COND_GT)
+        {
+          if (rhs.isConst() && rhs.value != INT_MAX)
+            rhs.value += 1;
+          else
+          {
+            std::swap(lhs, rhs);
+            taken = !taken;
+          }
+        }
+
+        int src0 = use(lhs, regalloc::SCRATCH0);
+        if (m_immSelect && rhs.isConst() && isImm16(rhs.value))
+          emit(mips::arithImm(mips::OP_SLTI, regalloc::SCRATCH0, src0, rhs.value));
+        else
+          emit(mips::arith(mips::OP_SLT, regalloc::SCRATCH0, src0, use(rhs, regalloc::SCRATCH1)));
+        emit(mips::branch(taken ? mips::OP_BNE : mips::OP_BEQ, regalloc::SCRATCH0, mips::REG_ZERO, target), instr.comment);
+      }
+
+      if (ifFalse != next)
+        emit(mips::jump(mips::OP_J, getLabel(ifFalse)));
+    }
+
+    // Bounds check with one unsigned compare, then an indirect jump through
+    // a word table of block labels in the data segment
+    void lowerSwitch(const ir::Instr& instr)
+    {
+      const auto& cases = m_func.getBlock(m_func.getLayout()[m_pos]).cases;
+      std::vector<std::string> labels;
+      for (auto&& target : cases)
+      {
+        labels.push_back(m_func.getBlock(target).name);
+        m_tableLabels.insert(getLabel(target));
+      }
+      int table = mips::addLabel(tables::addJumpTable(labels));
+
+      // Rebasing wraps instead of trapping, a value far outside the table
+      // still fails the unsigned bounds check
+      int index = use(instr.src[0], regalloc::SCRATCH0);
+      if (instr.imm != 0 && isImm16(-instr.imm))
+      {
+        emit(mips::arithImm(mips::OP_ADDIU, regalloc::SCRATCH0, index, -instr.imm));
+        index = regalloc::SCRATCH0;
+      }
+      else if (instr.imm != 0)
+      {
+        loadConst(regalloc::SCRATCH1, instr.imm);
+        emit(mips::arith(mips::OP_SUBU, regalloc::SCRATCH0, index, regalloc::SCRATCH1));
+        index = regalloc::SCRATCH0;
+      }
+      emit(mips::arithImm(mips::OP_SLTIU, regalloc::SCRATCH1, index, static_cast<int>(cases.size())));
+      emit(mips::branch(mips::OP_BEQ, regalloc::SCRATCH1, mips::REG_ZERO, getLabel(instr.target[0])));
+      emit(mips::arithImm(mips::OP_SLL, regalloc::SCRATCH1, index, 2));
+      emit(mips::loadAddr(regalloc::SCRATCH2, table));
+      emit(mips::arith(mips::OP_ADDU, regalloc::SCRATCH1, regalloc::SCRATCH1, regalloc::SCRATCH2));
+      emit(mips::load(regalloc::SCRATCH1, 0, regalloc::SCRATCH1));
+      emit(mips::jumpReg(regalloc::SCRATCH1), instr.comment);
+    }
+
+    // Arguments are moved into place right before the call, so nothing the
+    // lowering of other instructions does with $a0 can get in between
+    void lowerArg(const ir::Instr& instr)
+    {
+      if (instr.imm >= ARG_REGS)
+      {
+        emit(mips::store(use(instr.src[0], regalloc::SCRATCH0), 4 * (instr.imm - ARG_REGS), mips::REG_SP), instr.comment);
+        return;
+      }
+
+      int reg = mips::REG_A0 + instr.imm;
+      if (instr.src[0].isConst())
+        loadConst(reg, instr.src[0].value, instr.comment);
+      else
+        emit(mips::move(reg, use(instr.src[0], regalloc::SCRATCH0)), instr.comment);
+    }
+
+    void lowerReturn(const ir::Instr& instr)
+    {
+      if (instr.src[0].isConst())
+        loadConst(mips::REG_V0, instr.src[0].value);
+      else if (instr.src[0].isReg())
+        emit(mips::move(mips::REG_V0, use(instr.src[0], regalloc::SCRATCH0)));
+
+      for (auto&& saved : m_saved)
+        emit(mips::load(saved.first, saved.second, mips::REG_SP));
+      if (m_frameSize > 0)
+        emit(mips::arithImm(mips::OP_ADDI, mips::REG_SP, mips::REG_SP, m_frameSize));
+      emit(mips::jumpReg(mips::REG_RA), instr.comment);
+    }
+
+    void lowerInstr(const ir::Instr& instr)
+    {
+      switch (instr.op)
+      {
+      case ir::IR_COPY:
+        if (instr.src[0].isConst())
+          loadConst(def(instr.dst), instr.src[0].value, instr.comment);
+        else
+        {
+          // Coalesced copies need no code
+          int src = use(instr.src[0], regalloc::SCRATCH0);
+          if (src != def(instr.dst))
+            emit(mips::move(def(instr.dst), src), instr.comment);
+        }
+        spill(instr.dst);
+        break;
+      case ir::IR_LOAD:
+        emit(mips::load(def(instr.dst), instr.imm, mips::REG_GP), instr.comment);
+        spill(instr.dst);
+        break;
+      case ir::IR_STORE:
+        emit(mips::store(use(instr.src[0], regalloc::SCRATCH0), instr.imm, mips::REG_GP), instr.comment);
+        break;
+      case ir::IR_LOADADDR:
+        emit(mips::loadAddr(def(instr.dst), instr.imm), instr.comment);
+        spill(instr.dst);
+        break;
+      case ir::IR_READ:
+        emit(mips::loadImm(mips::OP_LI, mips::REG_V0, instr.imm), instr.comment);
+        emit(mips::syscall());
+        if (m_alloc.regs[instr.dst] != mips::REG_NONE)
+          emit(mips::move(def(instr.dst), mips::REG_V0));
+        spill(instr.dst, mips::REG_V0);
+        break;
+      case ir::IR_WRITE:
+        emit(mips::move(mips::REG_A0, use(instr.src[0], regalloc::SCRATCH0)));
+        emit(mips::loadImm(mips::OP_LI, mips::REG_V0, instr.imm), instr.comment);
+        emit(mips::syscall());
+        break;
+      case ir::IR_PARAM:
+        if (instr.imm < ARG_REGS)
+        {
+          if (m_alloc.regs[instr.dst] != mips::REG_NONE)
+            emit(mips::move(def(instr.dst), mips::REG_A0 + instr.imm), instr.comment);
+          spill(instr.dst, mips::REG_A0 + instr.imm);
+        }
+        else
+        {
+          // Stack arguments sit at the bottom of the caller's frame, right above this one
+          emit(mips::load(def(instr.dst), m_frameSize + 4 * (instr.imm - ARG_REGS), mips::REG_SP), instr.comment);
+          spill(instr.dst);
+        }
+        break;
+      case ir::IR_ARG:
+        lowerArg(instr);
+        break;
+      case ir::IR_CALL:
+        emit(mips::jump(mips::OP_JAL, instr.imm), instr.comment);
+        if (instr.dst >= 0)
+        {
+          if (m_alloc.regs[instr.dst] != mips::REG_NONE)
+            emit(mips::move(def(instr.dst), mips::REG_V0));
+          spill(instr.dst, mips::REG_V0);
+        }
+        break;
+      case ir::IR_RETURN:
+        lowerReturn(instr);
+        break;
+      case ir::IR_JUMP:
+        if (instr.target[0] != getNextBlock())
+          emit(mips::jump(mips::OP_J, getLabel(instr.target[0])), instr.comment);
+        break;
+      case ir::IR_BRANCH:
+        lowerBranch(instr);
+        break;
+      case ir::IR_SWITCH:
+        lowerSwitch(instr);
+        break;
+      case ir::IR_EXIT:
+        emit(mips::loadImm(mips::OP_LI, mips::REG_V0, SYSCALL_EXIT), instr.comment);
+        emit(mips::syscall());
+        break;
+      default:
+        lowerBinary(instr);
+        break;
+      }
+    }
+
+    const ir::Function& m_func;
+    mips::Function& m_out;
+    regalloc::Allocation m_alloc;
+    bool m_mulConst;
+    bool m_divConst;
+    bool m_immSelect;
+    std::set<int> m_labels;
+    std::set<int> m_tableLabels; // Labels only jump tables refer to
+    std::size_t m_start;
+    int m_pos;
+    int m_spillBase; // $sp offset of the first spill slot
+    int m_frameSize;
+    std::vector<std::pair<int, int>> m_saved; // Preserved register and its $sp offset
+  };
+}
+
+void codegen::lower(const ir::Function& func, mips::Function& out)
+{
+  Lowering(func, out).run();
+}
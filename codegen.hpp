@@ -0,0 +1,13 @@
+#ifndef CS5300_CODEGEN_HPP
+#define CS5300_CODEGEN_HPP
+
+// Project Includes
+#include "ir.hpp"
+#include "mips.hpp"
+
+namespace codegen
+{
+  void lower(const ir::Function& func, mips::Function& out);
+}
+
+#endif
@@ -1,10 +1,17 @@
 // Project Includes
+#include "codegen.hpp"
 #include "compiler.hpp"
+#include "ir.hpp"
 #include "logger.hpp"
+#include "mips.hpp"
+#include "passes.hpp"
 #include "tables.hpp"
 
  // Standard Includes
+#include <algorithm>
 #include <map>
+#include <memory>
+#include <set>
 #include <sstream>
 #include <vector>
 
@@ -18,55 +25,269 @@ namespace
   int loopCounter = 0;
   std::vector<std::string> idList;
   std::vector<std::pair<std::string, int>> loopList;
-  
-  void writeMain()
+
+  // A for loop keeps its counter and evaluated limit in virtual registers,
+  // the variable is only written back to memory when the loop exits
+  struct ForLoop
   {
-    logger::code(".globl main");
-    logger::code(".text");
-    logger::label("main");
-    logger::code("la $gp, GA");
-    logger::code("j prog");
+    int offset;
+    int counter;
+    ir::Operand limit;
+  };
+  std::vector<ForLoop> forList;
+
+  // Procedures and functions are parsed before the main block, each into its
+  // own IR function. Their parameters and variables live in virtual registers.
+  struct Procedure
+  {
+    std::string label;
+    std::vector<Type> params;
+    int result; // Type of a function's value, -1 for procedures
+    bool defined;
+  };
+  std::map<std::string, Procedure> procedures;
+  std::vector<std::unique_ptr<ir::Function>> functions;
+  std::string curProc; // Empty in the main block
+  std::vector<Type> curParams;
+
+  // Calls being parsed, innermost last, with their evaluated arguments
+  struct Call
+  {
+    std::string name;
+    std::vector<Expr*> args;
+  };
+  std::vector<Call> callList;
+  int callCount = 0;
+
+  ir::Function mainFunc("main");
+  ir::Function* program = &mainFunc; // Function the statements being parsed go into
+  int curBlock = -1;
+  std::map<std::string, int> blockIds;
+  int mainBlock = -1; // Where the main block continues once a procedure is parsed
+  std::set<int> readOffsets; // Variables the source reads, by $gp offset
+
+  int getComment(const std::string& comment)
+  {
+    return comment.empty() ? -1 : mips::addComment(comment);
+  }
 
-    // TODO: This needs to be moved when functions are supported
-    logger::label("prog");
+  void emit(ir::Instr instr, const std::string& comment = "")
+  {
+    instr.comment = getComment(comment);
+    program->getBlock(curBlock).instrs.push_back(instr);
   }
 
-  std::string getExprStr(Expr* expr)
+  ir::Operand operand(Expr* expr)
   {
-    std::string str = "Expr(";
-    if (expr)
-      str += std::to_string(expr->exprNum);
-    else
-      str += "empty";
-    str += ")";
-    return str;
+    if (expr->reg >= 0)
+      return ir::Operand::reg(expr->reg);
+    return ir::Operand::constant(expr->intVal);
   }
 
-  std::string getRegStr(Expr* expr)
+  int emitBinary(ir::Opcode op, ir::Operand lhs, ir::Operand rhs, const std::string& comment = "")
   {
-    return std::to_string(expr->intVal) + "(" + expr->strVal + ")";
+    int dst = program->newVReg();
+    emit(ir::binary(op, dst, lhs, rhs), comment);
+    return dst;
   }
 
-  std::string getInstStr(const std::string& inst, const std::string& arg1, const std::string& arg2 = "", const std::string& arg3 = "")
+  int emitBinary(ir::Opcode op, Expr* lhs, Expr* rhs, const std::string& comment = "")
   {
-    // TODO: Format so it looks nicer
-    std::string str = inst + " " + arg1;
-    if (!arg2.empty()) str += ", " + arg2;
-    if (!arg3.empty()) str += ", " + arg3;
-    return str;
+    return emitBinary(op, operand(lhs), operand(rhs), comment);
+  }
+
+  // Booleans are 0 or 1, other types are converted by comparing with zero
+  ir::Operand toBoolean(Expr* expr)
+  {
+    if (expr->type == TYPE_BOOL)
+      return operand(expr);
+    if (expr->isConst)
+      return ir::Operand::constant(expr->intVal != 0);
+    return ir::Operand::reg(emitBinary(ir::IR_SNE, operand(expr), ir::Operand::constant(0)));
+  }
+
+  // Points expr at a newly computed register, forgetting what was known about the old one
+  void setResult(Expr* expr, int reg)
+  {
+    expr->reg = reg;
+    expr->var = -1;
+    expr->base = -1;
+    expr->addend = 0;
+    expr->negated = -1;
+  }
+
+  void setConst(Expr* expr, int value)
+  {
+    setResult(expr, -1);
+    expr->isConst = true;
+    expr->intVal = value;
+  }
+
+  void setAlias(Expr* expr, const Expr* value)
+  {
+    if (expr == value)
+      return;
+    setResult(expr, value->reg);
+    expr->var = value->var;
+    expr->calls = value->calls;
+    expr->base = value->base;
+    expr->addend = value->addend;
+    expr->negated = value->negated;
   }
 
-  std::string getArithInstStr(const std::string& inst, Expr* expr1, Expr* expr2, Expr* expr3 = nullptr, bool immediate = false)
+  // Reads of the same variable within one expression see the same value
+  // unless a call, which may assign it, was emitted between them
+  bool isSameValue(const Expr* lhs, const Expr* rhs)
   {
-    if (expr3)
+    if (lhs->isConst || rhs->isConst)
+      return false;
+    return lhs->reg == rhs->reg || (lhs->var >= 0 && lhs->var == rhs->var && lhs->calls == rhs->calls);
+  }
+
+  // Operations on constants wrap like the hardware, the one overflowing division gives the dividend
+  int foldConstants(ir::Opcode op, int lhs, int rhs)
+  {
+    int result;
+    if (!ir::fold(op, lhs, rhs, result))
+      return op == ir::IR_DIV ? lhs : 0;
+    return result;
+  }
+
+  // (x + c1) + c2 becomes x + (c1 + c2), which is x again when the constants cancel
+  void buildAddConst(Expr* result, Expr* lhs, int value)
+  {
+    int base = lhs->base >= 0 ? lhs->base : lhs->reg;
+    int addend = foldConstants(ir::IR_ADD, lhs->base >= 0 ? lhs->addend : 0, value);
+    if (addend == 0)
     {
-      if (immediate)
-        return getInstStr(inst, expr1->reg->getName(), expr2->reg->getName(), std::to_string(expr3->intVal));
-      return getInstStr(inst, expr1->reg->getName(), expr2->reg->getName(), expr3->reg->getName());
+      if (lhs->base >= 0)
+        setResult(result, base);
+      else
+        setAlias(result, lhs);
+      return;
     }
-    if (immediate)
-      return getInstStr(inst, expr1->reg->getName(), std::to_string(expr2->intVal));
-    return getInstStr(inst, expr1->reg->getName(), expr2->reg->getName());
+    setResult(result, emitBinary(ir::IR_ADD, ir::Operand::reg(base), ir::Operand::constant(addend)));
+    result->base = base;
+    result->addend = addend;
+  }
+
+  // Builds lhs op rhs into result with constants on the right, applying
+  // identities and annihilators before emitting an instruction
+  void buildBinary(Expr* result, ir::Opcode op, Expr* lhs, Expr* rhs)
+  {
+    if (lhs->isConst && !rhs->isConst && (ir::isCommutative(op) || ir::getSwapped(op) != op))
+    {
+      std::swap(lhs, rhs);
+      op = ir::getSwapped(op);
+    }
+
+    if (isSameValue(lhs, rhs))
+    {
+      switch (op)
+      {
+      case ir::IR_SUB:
+      case ir::IR_XOR:
+      case ir::IR_SNE:
+      case ir::IR_SLT:
+      case ir::IR_SGT:
+        setConst(result, 0);
+        return;
+      case ir::IR_SEQ:
+      case ir::IR_SLE:
+      case ir::IR_SGE:
+        setConst(result, 1);
+        return;
+      default:
+        break;
+      }
+    }
+
+    if (rhs->isConst)
+    {
+      int value = rhs->intVal;
+      switch (op)
+      {
+      case ir::IR_ADD:
+        buildAddConst(result, lhs, value);
+        return;
+      case ir::IR_SUB:
+        buildAddConst(result, lhs, foldConstants(ir::IR_SUB, 0, value));
+        return;
+      case ir::IR_MUL:
+        if (value == 0)
+        {
+          setConst(result, 0);
+          return;
+        }
+        if (value == 1)
+        {
+          setAlias(result, lhs);
+          return;
+        }
+        break;
+      case ir::IR_DIV:
+        if (value == 1)
+        {
+          setAlias(result, lhs);
+          return;
+        }
+        break;
+      case ir::IR_MOD:
+        if (value == 1 || value == -1)
+        {
+          setConst(result, 0);
+          return;
+        }
+        break;
+      default:
+        break;
+      }
+    }
+
+    setResult(result, emitBinary(op, lhs, rhs));
+  }
+
+  // Finds a named block, creating it on first reference so branches can target blocks that are placed later
+  int getBlock(const std::string& name)
+  {
+    auto found = blockIds.find(name);
+    if (found != blockIds.end())
+      return found->second;
+
+    int id = program->addBlock(name);
+    blockIds[name] = id;
+    return id;
+  }
+
+  void startBlock(int id)
+  {
+    program->placeBlock(id);
+    curBlock = id;
+  }
+
+  void jumpTo(int id)
+  {
+    emit(ir::jump(id));
+    startBlock(id);
+  }
+
+  void writeMain(mips::Function& code)
+  {
+    logger::code(".globl main");
+    logger::code(".text");
+    code.emit(mips::label(mips::addLabel("main")));
+    code.emit(mips::loadAddr(mips::REG_GP, mips::addLabel("GA")));
+  }
+
+  std::string getExprStr(Expr* expr)
+  {
+    std::string str = "Expr(";
+    if (expr)
+      str += std::to_string(expr->exprNum);
+    else
+      str += "empty";
+    str += ")";
+    return str;
   }
 
   std::string getTypeStr(Type type)
@@ -137,9 +358,20 @@ namespace
       loopList.pop_back();
   }
 
-  Expr* getLoopCounter()
+  bool isLocal(const Expr* expr)
   {
-    return loadExpr(lvalueExpr(loopList.back().first));
+    return expr->strVal == "local" && !expr->isConst;
+  }
+
+  // Register holding a variable while it is the counter of an enclosing for loop, -1 otherwise
+  int getCounterReg(int offset)
+  {
+    for (auto it = forList.rbegin(); it != forList.rend(); ++it)
+    {
+      if (it->offset == offset)
+        return it->counter;
+    }
+    return -1;
   }
 
   std::string getLoopLabel(const std::string& label)
@@ -147,12 +379,134 @@ namespace
     return label + "_" + std::to_string(loopList.back().second);
   }
 
-  void loadImmediate(Expr* expr)
+  void forLimit(Expr* expr)
+  {
+    // Evaluated once, into its own register in case the expression is a counter the body assigns to
+    auto& loop = forList.back();
+    loop.limit = operand(expr);
+    if (loop.limit.isReg())
+    {
+      int limit = program->newVReg();
+      emit(ir::copy(limit, loop.limit), "For loop limit");
+      loop.limit = ir::Operand::reg(limit);
+    }
+    jumpTo(getBlock(getLoopLabel("for")));
+    delete expr;
+  }
+
+  // A callee may read and assign the global variables counting enclosing for
+  // loops, so their registers are written back before a call or a return and
+  // reloaded after a call
+  void storeCounters()
+  {
+    for (auto&& loop : forList)
+    {
+      if (loop.offset >= 0)
+        emit(ir::store(loop.offset, ir::Operand::reg(loop.counter)), "Write back for loop counter");
+    }
+  }
+
+  void loadCounters()
   {
-    if (!expr->reg)
+    for (auto&& loop : forList)
     {
-      expr->reg = Register::allocate();
-      logger::code(getInstStr("li", expr->reg->getName(), std::to_string(expr->intVal)));
+      if (loop.offset >= 0)
+        emit(ir::load(loop.counter, loop.offset), "Reload for loop counter");
+    }
+  }
+
+  // Checks the arguments of the innermost call against the declaration and
+  // emits it, returning the register receiving a function's value
+  int emitCall(bool isExpr)
+  {
+    auto call = std::move(callList.back());
+    callList.pop_back();
+
+    auto found = procedures.find(call.name);
+    if (found == procedures.end())
+      logger::compileError("Procedure '" + call.name + "' was not declared");
+    const auto& proc = found->second;
+    if (isExpr && proc.result < 0)
+      logger::compileError("Procedure '" + call.name + "' does not return a value");
+    if (call.args.size() != proc.params.size())
+      logger::compileError("'" + call.name + "' expects " + std::to_string(proc.params.size()) + " arguments, got " + std::to_string(call.args.size()));
+    for (std::size_t i = 0; i < call.args.size(); ++i)
+    {
+      if (call.args[i]->type != proc.params[i])
+        logger::compileError("Incompatible types: argument " + std::to_string(i + 1) + " of '" + call.name + "' should be '" + getTypeStr(proc.params[i]) + "'");
+    }
+
+    // Arguments are all evaluated before the first one is passed, a call
+    // among them would overwrite the argument registers
+    storeCounters();
+    for (std::size_t i = 0; i < call.args.size(); ++i)
+    {
+      emit(ir::arg(static_cast<int>(i), operand(call.args[i])), "Argument " + std::to_string(i + 1) + " of '" + call.name + "'");
+      delete call.args[i];
+    }
+    int dst = proc.result >= 0 ? program->newVReg() : -1;
+    emit(ir::call(dst, mips::addLabel(proc.label)), "Call '" + call.name + "'");
+    ++callCount;
+    loadCounters();
+    return dst;
+  }
+
+  // Goes back to emitting into the main block
+  void endProcedure()
+  {
+    tables::popTable();
+    program = &mainFunc;
+    curBlock = mainBlock;
+    curProc.clear();
+  }
+
+  std::vector<ir::Function*> getFunctions()
+  {
+    std::vector<ir::Function*> result(1, &mainFunc);
+    for (auto&& func : functions)
+      result.push_back(func.get());
+    return result;
+  }
+
+  // Drops variables the optimized program no longer loads or stores from GA.
+  // Stores to variables the source never reads go first, with whatever only
+  // computed their values, even where a call or return kept them alive.
+  void packGlobals()
+  {
+    std::set<int> used;
+    for (auto&& func : getFunctions())
+    {
+      for (auto&& id : func->getLayout())
+      {
+        auto& instrs = func->getBlock(id).instrs;
+        instrs.erase(std::remove_if(instrs.begin(), instrs.end(), [](const ir::Instr& instr)
+        {
+          return instr.op == ir::IR_STORE && !readOffsets.count(instr.imm);
+        }), instrs.end());
+      }
+      passes::deadCode(*func);
+
+      for (auto&& id : func->getLayout())
+      {
+        for (auto&& instr : func->getBlock(id).instrs)
+        {
+          if (instr.op == ir::IR_LOAD || instr.op == ir::IR_STORE)
+            used.insert(instr.imm);
+        }
+      }
+    }
+
+    auto moved = tables::packGlobals(used, readOffsets);
+    for (auto&& func : getFunctions())
+    {
+      for (auto&& id : func->getLayout())
+      {
+        for (auto&& instr : func->getBlock(id).instrs)
+        {
+          if (instr.op == ir::IR_LOAD || instr.op == ir::IR_STORE)
+            instr.imm = moved[instr.imm];
+        }
+      }
     }
   }
 }
@@ -163,13 +517,41 @@ void startProgram()
   tables::addBoolean("FALSE", true, 0);
   tables::addBoolean("true", true, 1);
   tables::addBoolean("TRUE", true, 1);
-  writeMain();
+  startBlock(getBlock("prog"));
   yyparse();
 }
 
 void endProgram()
 {
+  for (auto&& proc : procedures)
+  {
+    if (!proc.second.defined)
+      logger::compileError("Procedure '" + proc.first + "' was declared forward but never defined");
+  }
+
+  emit(ir::exit());
+  for (auto&& func : getFunctions())
+    passes::runIr(*func);
+  if (passes::isEnabled("prune-globals"))
+    packGlobals();
+
+  mips::Function code(mainFunc.getName());
+  writeMain(code);
+  codegen::lower(mainFunc, code);
+  passes::runMachine(code);
+  mips::write(code);
+
+  for (auto&& func : functions)
+  {
+    mips::Function procCode(func->getName());
+    procCode.emit(mips::label(mips::addLabel(func->getName())));
+    codegen::lower(*func, procCode);
+    passes::runMachine(procCode);
+    mips::write(procCode);
+  }
+
   tables::writeTables();
+  logger::flush();
 }
 
 void addConst(const std::string& id, Expr* expr)
@@ -207,6 +589,19 @@ void addVars(int type)
   for (auto&& id : idList)
     logger::debug("Adding Variable: " + getTypeStr(realType) + " " + id);
 
+  // Variables of a procedure start out zero on every call, like those in GA
+  if (!curProc.empty() && realType != TYPE_STRING)
+  {
+    for (auto&& id : idList)
+    {
+      int vreg = program->newVReg();
+      emit(ir::copy(vreg, ir::Operand::constant(0)), "Initialize " + getTypeStr(realType) + " '" + id + "'");
+      tables::addLocal(id, realType, vreg);
+    }
+    idList.clear();
+    return;
+  }
+
   switch (realType)
   {
   case TYPE_BOOL:
@@ -225,6 +620,63 @@ void addVars(int type)
   idList.clear();
 }
 
+void procBegin(const std::string& name)
+{
+  logger::debug("Procedure " + name);
+
+  curProc = name;
+  curParams.clear();
+  functions.emplace_back(new ir::Function("proc_" + name));
+  program = functions.back().get();
+  mainBlock = curBlock;
+  tables::pushTable();
+  startBlock(program->addBlock());
+}
+
+void addParams(int isRef, int type)
+{
+  if (isRef)
+    logger::compileError("Reference parameters are not supported, '" + idList.front() + "' must be passed by value");
+
+  Type realType = static_cast<Type>(type);
+  for (auto&& id : idList)
+  {
+    int vreg = program->newVReg();
+    emit(ir::param(vreg, static_cast<int>(curParams.size())), "Parameter '" + id + "'");
+    tables::addLocal(id, realType, vreg);
+    curParams.push_back(realType);
+  }
+  idList.clear();
+}
+
+void procDecl(int type)
+{
+  auto found = procedures.find(curProc);
+  if (found == procedures.end())
+  {
+    procedures[curProc] = { "proc_" + curProc, curParams, type, false };
+    return;
+  }
+
+  if (found->second.defined)
+    logger::compileError("Multiple definitions: Procedure '" + curProc + "' is already defined");
+  if (found->second.params != curParams || found->second.result != type)
+    logger::compileError("Procedure '" + curProc + "' does not match its forward declaration");
+}
+
+void procForward()
+{
+  functions.pop_back();
+  endProcedure();
+}
+
+void procEnd()
+{
+  procedures[curProc].defined = true;
+  emit(ir::ret(ir::Operand::none()), "Return from '" + curProc + "'");
+  endProcedure();
+}
+
 int simpleType(const std::string& id)
 {
   if (id == "boolean" || id == "BOOLEAN") return TYPE_BOOL;
@@ -242,8 +694,13 @@ void assignExpr(Expr* lhs, Expr* rhs)
   if (lhs->isConst)
     logger::compileError("Invalid L-value: symbol '" + lhs->name + "' should be non-const");
 
-  loadImmediate(rhs);
-  logger::code(getInstStr("sw", rhs->reg->getName(), getRegStr(lhs)), "Assign to " + getTypeStr(lhs->type) + " '" + lhs->name + "'");
+  int counter = getCounterReg(lhs->intVal);
+  if (isLocal(lhs))
+    emit(ir::copy(lhs->intVal, operand(rhs)), "Assign to " + getTypeStr(lhs->type) + " '" + lhs->name + "'");
+  else if (counter >= 0)
+    emit(ir::copy(counter, operand(rhs)), "Assign to for loop counter '" + lhs->name + "'");
+  else
+    emit(ir::store(lhs->intVal, operand(rhs)), "Assign to " + getTypeStr(lhs->type) + " '" + lhs->name + "'");
 
   delete lhs;
   delete rhs;
@@ -257,19 +714,25 @@ void readExpr(Expr* expr)
   if (expr->isConst)
     logger::compileError("Invalid L-value: symbol '" + expr->name + "' should be non-const");
 
+  int value = program->newVReg();
   switch (expr->type)
   {
   case TYPE_BOOL:
   case TYPE_INT:
-    logger::code(getInstStr("li", "$v0", "5"), "Read " + getTypeStr(expr->type));
+    emit(ir::read(value, 5), "Read " + getTypeStr(expr->type));
     break;
   case TYPE_CHAR:
-    logger::code(getInstStr("li", "$v0", "12"), "Read character");
+    emit(ir::read(value, 12), "Read character");
     break;
   }
 
-  logger::code("syscall");
-  logger::code(getInstStr("sw", "$v0", getRegStr(expr)));
+  int counter = getCounterReg(expr->intVal);
+  if (isLocal(expr))
+    emit(ir::copy(expr->intVal, ir::Operand::reg(value)));
+  else if (counter >= 0)
+    emit(ir::copy(counter, ir::Operand::reg(value)));
+  else
+    emit(ir::store(expr->intVal, ir::Operand::reg(value)));
 
   delete expr;
 }
@@ -277,115 +740,170 @@ void readExpr(Expr* expr)
 void writeExpr(Expr* expr)
 {
   logger::debug("WRITE " + getExprStr(expr));
-  loadImmediate(expr);
-  logger::code(getInstStr("move", "$a0", expr->reg->getName()));
 
   switch (expr->type)
   {
   case TYPE_BOOL:
   case TYPE_INT:
-    logger::code(getInstStr("li", "$v0", "1"), "Write " + getTypeStr(expr->type));
+    emit(ir::write(operand(expr), 1), "Write " + getTypeStr(expr->type));
     break;
   case TYPE_CHAR:
-    logger::code(getInstStr("li", "$v0", "11"), "Write character");
+    emit(ir::write(operand(expr), 11), "Write character");
     break;
   case TYPE_STRING:
-    logger::code(getInstStr("li", "$v0", "4"), "Write string");
+    emit(ir::write(operand(expr), 4), "Write string");
     break;
   }
 
-  logger::code("syscall");
+  delete expr;
+}
 
+void stop()
+{
+  logger::debug("STOP");
+
+  // Statements after stop are unreachable, they go into a block with no predecessors
+  emit(ir::exit(), "Stop");
+  startBlock(program->addBlock());
+}
+
+// Return in the main block ends the program like stop
+void returnStmt(Expr* expr)
+{
+  logger::debug("RETURN " + getExprStr(expr));
+
+  if (curProc.empty())
+  {
+    if (expr)
+      logger::compileError("The main block cannot return a value");
+    emit(ir::exit(), "Return from the main block");
+    startBlock(program->addBlock());
+    return;
+  }
+
+  int result = procedures[curProc].result;
+  if (result < 0 && expr)
+    logger::compileError("Procedure '" + curProc + "' cannot return a value");
+  if (result >= 0 && !expr)
+    logger::compileError("Function '" + curProc + "' must return a value");
+  if (expr && expr->type != result)
+    logger::compileError("Incompatible types: '" + getTypeStr(expr->type) + "' does not match '" + getTypeStr(static_cast<Type>(result)) + "'");
+
+  storeCounters();
+  emit(ir::ret(expr ? operand(expr) : ir::Operand::none()), "Return from '" + curProc + "'");
+  startBlock(program->addBlock());
   delete expr;
 }
 
+void callBegin(const std::string& name)
+{
+  callList.push_back({ name, {} });
+}
+
+void addArg(Expr* expr)
+{
+  callList.back().args.push_back(expr);
+}
+
+void callProc()
+{
+  emitCall(false);
+}
+
 
 void forInit(const std::string& lhs, Expr* rhs)
 {
   pushLoop(lhs);
-  logger::comment("Init for loop counter");
-  assignExpr(lvalueExpr(lhs), rhs);
-  logger::label(getLoopLabel("for"));
+  auto var = lvalueExpr(lhs);
+  checkTypes(var, rhs);
+  if (var->isConst)
+    logger::compileError("Invalid L-value: symbol '" + var->name + "' should be non-const");
+
+  // The limit is evaluated after the initial value, before the loop header.
+  // A variable of a procedure is its own counter and never written back, a
+  // variable an enclosing loop already counts keeps that loop's register.
+  int counter = isLocal(var) ? var->intVal : getCounterReg(var->intVal);
+  if (counter < 0)
+    counter = program->newVReg();
+  emit(ir::copy(counter, operand(rhs)), "Initialize for loop counter '" + lhs + "'");
+  forList.push_back({ isLocal(var) ? -1 : var->intVal, counter, ir::Operand::none() });
+  delete var;
+  delete rhs;
 }
 
 int forDownTo(Expr* expr)
 {
-  logger::comment("Check for loop condition");
-  auto counter = getLoopCounter();
-  loadImmediate(expr);
-  logger::code(getInstStr("slt", expr->reg->getName(), counter->reg->getName(), expr->reg->getName()), "For loop comparison");
-  logger::code(getInstStr("bne", expr->reg->getName(), "$zero", getLoopLabel("for_done")), "End foor loop if comparison is true");
-  logger::comment("For loop body");
-  delete counter;
-  delete expr;
+  forLimit(expr);
+  const auto& loop = forList.back();
+  int body = program->addBlock();
+  emit(ir::branch(ir::COND_LT, ir::Operand::reg(loop.counter), loop.limit, getBlock(getLoopLabel("for_done")), body), "End for loop if counter is below the limit");
+  startBlock(body);
   return -1;
 }
 
 int forTo(Expr* expr)
 {
-  logger::comment("Check for loop condition");
-  auto counter = getLoopCounter();
-  loadImmediate(expr);
-  logger::code(getInstStr("slt", expr->reg->getName(), expr->reg->getName(), counter->reg->getName()), "For loop comparison");
-  logger::code(getInstStr("bne", expr->reg->getName(), "$zero", getLoopLabel("for_done")), "End for loop if comparison is true");
-  logger::comment("For loop body");
-  delete counter;
-  delete expr;
+  forLimit(expr);
+  const auto& loop = forList.back();
+  int body = program->addBlock();
+  emit(ir::branch(ir::COND_GT, ir::Operand::reg(loop.counter), loop.limit, getBlock(getLoopLabel("for_done")), body), "End for loop if counter is above the limit");
+  startBlock(body);
   return 1;
 }
 
 void forCounter(int val)
 {
-  auto counter = getLoopCounter();
+  const auto loop = forList.back();
   std::string action = val == 1 ? "Increment" : "Decrement";
-  logger::comment("Update for loop counter");
-  logger::code(getInstStr("addi", counter->reg->getName(), counter->reg->getName(), std::to_string(val)), action + " for loop counter");
-  logger::code(getInstStr("sw", counter->reg->getName(), getRegStr(counter)));
-  logger::code(getInstStr("j", getLoopLabel("for")));
-  logger::label(getLoopLabel("for_done"));
+  auto counter = ir::Operand::reg(loop.counter);
+  emit(ir::binary(ir::IR_ADD, loop.counter, counter, ir::Operand::constant(val)), action + " for loop counter");
+  emit(ir::jump(getBlock(getLoopLabel("for"))));
+  startBlock(getBlock(getLoopLabel("for_done")));
+  if (loop.offset >= 0)
+    emit(ir::store(loop.offset, counter), "Write back for loop counter");
+  forList.pop_back();
   popLoop();
-  delete counter;
 }
 
 void ifBegin()
 {
-  logger::comment("If statement");
   pushLoop();
 }
 
 void ifCondition(Expr* expr)
 {
   pushLoop();
-  loadImmediate(expr);
-  logger::code(getInstStr("beq", expr->reg->getName(), "$zero", getLoopLabel("else")), "Jump if condition is false");
+  int then = program->addBlock();
+  emit(ir::branch(ir::COND_EQ, operand(expr), ir::Operand::constant(0), getBlock(getLoopLabel("else")), then), "Jump if condition is false");
+  startBlock(then);
   delete expr;
 }
 
 void ifThen()
 {
-  auto label = getLoopLabel("else");
+  auto elseLabel = getLoopLabel("else");
   popLoop();
-  logger::code(getInstStr("j", getLoopLabel("if_done")), "Jump to the end of the if statement");
-  logger::label(label);
+  emit(ir::jump(getBlock(getLoopLabel("if_done"))), "Jump to the end of the if statement");
+  startBlock(getBlock(elseLabel));
 }
 
 void ifEnd()
 {
-  logger::label(getLoopLabel("if_done"));
+  jumpTo(getBlock(getLoopLabel("if_done")));
   popLoop();
 }
 
 void repeatBegin()
 {
   pushLoop();
-  logger::label(getLoopLabel("repeat"));
+  jumpTo(getBlock(getLoopLabel("repeat")));
 }
 
 void repeatCondition(Expr* expr)
 {
-  loadImmediate(expr);
-  logger::code(getInstStr("beq", expr->reg->getName(), "$zero", getLoopLabel("repeat")), "Repeat if condition is false");
-  logger::comment("Done repeating: " + getLoopLabel("repeat"));
+  int done = program->addBlock();
+  emit(ir::branch(ir::COND_EQ, operand(expr), ir::Operand::constant(0), getBlock(getLoopLabel("repeat")), done), "Repeat if condition is false");
+  startBlock(done);
   popLoop();
   delete expr;
 }
@@ -393,20 +911,21 @@ void repeatCondition(Expr* expr)
 void whileBegin()
 {
   pushLoop();
-  logger::label(getLoopLabel("while"));
+  jumpTo(getBlock(getLoopLabel("while")));
 }
 
 void whileCondition(Expr* expr)
 {
-  loadImmediate(expr);
-  logger::code(getInstStr("beq", expr->reg->getName(), "$zero", getLoopLabel("while_done")), "End while loop if condition is false");
+  int body = program->addBlock();
+  emit(ir::branch(ir::COND_EQ, operand(expr), ir::Operand::constant(0), getBlock(getLoopLabel("while_done")), body), "End while loop if condition is false");
+  startBlock(body);
   delete expr;
 }
 
 void whileEnd()
 {
-  logger::code(getInstStr("j", getLoopLabel("while")));
-  logger::label(getLoopLabel("while_done"));
+  emit(ir::jump(getBlock(getLoopLabel("while"))));
+  startBlock(getBlock(getLoopLabel("while_done")));
   popLoop();
 }
 
@@ -419,36 +938,15 @@ Expr* addExpr(Expr* lhs, Expr* rhs)
   newExpr->exprNum = curSymbol++;
   newExpr->type = lhs->type;
 
-  if (lhs->isConst)
+  newExpr->isConst = lhs->isConst && rhs->isConst;
+
+  if (newExpr->isConst)
   {
-    if (rhs->isConst)
-    {
-      newExpr->isConst = true;
-      newExpr->intVal = lhs->intVal + rhs->intVal;
-      logger::debug("Resulting " + getTypeStr(newExpr->type) + ": " + std::to_string(newExpr->intVal) + " = " + std::to_string(lhs->intVal) + " + " + std::to_string(rhs->intVal));
-    }
-    else
-    {
-      newExpr->isConst = false;
-      newExpr->reg = Register::allocate();
-      logger::code(getArithInstStr("addi", newExpr, rhs, lhs, true));
-    }
+    newExpr->intVal = foldConstants(ir::IR_ADD, lhs->intVal, rhs->intVal);
+    logger::debug("Resulting " + getTypeStr(newExpr->type) + ": " + std::to_string(newExpr->intVal) + " = " + std::to_string(lhs->intVal) + " + " + std::to_string(rhs->intVal));
   }
   else
-  {
-    if (rhs->isConst)
-    {
-      newExpr->isConst = false;
-      newExpr->reg = Register::allocate();
-      logger::code(getArithInstStr("addi", newExpr, lhs, rhs, true));
-    }
-    else
-    {
-      newExpr->isConst = false;
-      newExpr->reg = Register::allocate();
-      logger::code(getArithInstStr("add", newExpr, lhs, rhs));
-    }
-  }
+    buildBinary(newExpr, ir::IR_ADD, lhs, rhs);
 
   delete lhs;
   delete rhs;
@@ -474,13 +972,21 @@ Expr* andExpr(Expr* lhs, Expr* rhs)
     newExpr->intVal = lhs->intVal && rhs->intVal;
     logger::debug("Resulting " + getTypeStr(newExpr->type) + ": " + std::to_string(newExpr->intVal) + " = " + std::to_string(lhs->intVal) + " && " + std::to_string(rhs->intVal));
   }
+  else if (lhs->isConst || rhs->isConst)
+  {
+    // true & x is x and false & x is false
+    auto value = lhs->isConst ? rhs : lhs;
+    auto other = lhs->isConst ? lhs : rhs;
+    if (other->intVal == 0)
+      setConst(newExpr, 0);
+    else
+      setResult(newExpr, toBoolean(value).value);
+  }
+  else if (isSameValue(lhs, rhs))
+    setResult(newExpr, toBoolean(lhs).value);
   else
   {
-    newExpr->reg = Register::allocate();
-    loadImmediate(lhs);
-    loadImmediate(rhs);
-    logger::code(getArithInstStr("and", newExpr, lhs, rhs));
-    logger::code(getInstStr("sne", newExpr->reg->getName(), newExpr->reg->getName(), "$zero"));
+    newExpr->reg = emitBinary(ir::IR_AND, toBoolean(lhs), toBoolean(rhs));
   }
 
   delete lhs;
@@ -489,6 +995,20 @@ Expr* andExpr(Expr* lhs, Expr* rhs)
   return newExpr;
 }
 
+Expr* callExpr()
+{
+  auto name = callList.back().name;
+  printExpr("CALL " + name);
+
+  auto newExpr = new Expr;
+  newExpr->exprNum = curSymbol++;
+  newExpr->isConst = false;
+  newExpr->reg = emitCall(true);
+  newExpr->type = static_cast<Type>(procedures[name].result);
+  newExpr->name = name;
+  return newExpr;
+}
+
 Expr* charExpr(int expr)
 {
   std::string s = "0";
@@ -530,17 +1050,11 @@ Expr* divExpr(Expr* lhs, Expr* rhs)
   {
     if (rhs->intVal == 0)
       logger::compileError("Cannot divide by zero");
-    newExpr->intVal = lhs->intVal / rhs->intVal;
+    newExpr->intVal = foldConstants(ir::IR_DIV, lhs->intVal, rhs->intVal);
     logger::debug("Resulting " + getTypeStr(newExpr->type) + ": " + std::to_string(newExpr->intVal) + " = " + std::to_string(lhs->intVal) + " / " + std::to_string(rhs->intVal));
   }
   else
-  {
-    newExpr->reg = Register::allocate();
-    loadImmediate(lhs);
-    loadImmediate(rhs);
-    logger::code(getArithInstStr("div", lhs, rhs));
-    logger::code(getInstStr("mflo", newExpr->reg->getName()));
-  }
+    buildBinary(newExpr, ir::IR_DIV, lhs, rhs);
 
   delete lhs;
   delete rhs;
@@ -564,12 +1078,7 @@ Expr* eqExpr(Expr* lhs, Expr* rhs)
     logger::debug("Resulting " + getTypeStr(newExpr->type) + ": " + std::to_string(newExpr->intVal) + " = " + std::to_string(lhs->intVal) + " == " + std::to_string(rhs->intVal));
   }
   else
-  {
-    newExpr->reg = Register::allocate();
-    loadImmediate(lhs);
-    loadImmediate(rhs);
-    logger::code(getArithInstStr("seq", newExpr, lhs, rhs));
-  }
+    buildBinary(newExpr, ir::IR_SEQ, lhs, rhs);
 
   delete lhs;
   delete rhs;
@@ -593,12 +1102,7 @@ Expr* gtExpr(Expr* lhs, Expr* rhs)
     logger::debug("Resulting " + getTypeStr(newExpr->type) + ": " + std::to_string(newExpr->intVal) + " = " + std::to_string(lhs->intVal) + " > " + std::to_string(rhs->intVal));
   }
   else
-  {
-    newExpr->reg = Register::allocate();
-    loadImmediate(lhs);
-    loadImmediate(rhs);
-    logger::code(getArithInstStr("sgt", newExpr, lhs, rhs));
-  }
+    buildBinary(newExpr, ir::IR_SGT, lhs, rhs);
 
   delete lhs;
   delete rhs;
@@ -622,12 +1126,7 @@ Expr* gteExpr(Expr* lhs, Expr* rhs)
     logger::debug("Resulting " + getTypeStr(newExpr->type) + ": " + std::to_string(newExpr->intVal) + " = " + std::to_string(lhs->intVal) + " >= " + std::to_string(rhs->intVal));
   }
   else
-  {
-    newExpr->reg = Register::allocate();
-    loadImmediate(lhs);
-    loadImmediate(rhs);
-    logger::code(getArithInstStr("sge", newExpr, lhs, rhs));
-  }
+    buildBinary(newExpr, ir::IR_SGE, lhs, rhs);
 
   delete lhs;
   delete rhs;
@@ -650,19 +1149,33 @@ Expr* intExpr(int expr)
 Expr* loadExpr(Expr* expr)
 {
   // TODO: Check for nullptr everywhere
-  if (expr->type == TYPE_STRING)
+  if (isLocal(expr))
+    expr->reg = expr->intVal;
+  else if (expr->type == TYPE_STRING)
   {
-    expr->reg = Register::allocate();
-    logger::code(getInstStr("la", expr->reg->getName(), expr->strVal), "Load string '" + expr->name + "'");
+    expr->reg = program->newVReg();
+    emit(ir::loadAddr(expr->reg, mips::addLabel(expr->strVal)), "Load string '" + expr->name + "'");
   }
   else if (expr->isConst)
   {
     logger::debug("Load const " + getTypeStr(expr->type) + " '" + expr->name + " = " + std::to_string(expr->intVal) + "'");
   }
+  else if (getCounterReg(expr->intVal) >= 0)
+  {
+    // Copied, a call later in the expression reloads the counter's register
+    expr->reg = program->newVReg();
+    emit(ir::copy(expr->reg, ir::Operand::reg(getCounterReg(expr->intVal))));
+    expr->var = expr->intVal;
+    expr->calls = callCount;
+    readOffsets.insert(expr->intVal);
+  }
   else
   {
-    expr->reg = Register::allocate();
-    logger::code(getInstStr("lw", expr->reg->getName(), getRegStr(expr)), "Load " + getTypeStr(expr->type) + " '" + expr->name + "'");
+    expr->reg = program->newVReg();
+    expr->var = expr->intVal;
+    expr->calls = callCount;
+    readOffsets.insert(expr->intVal);
+    emit(ir::load(expr->reg, expr->intVal), "Load " + getTypeStr(expr->type) + " '" + expr->name + "'");
   }
 
   return expr;
@@ -684,12 +1197,7 @@ Expr* ltExpr(Expr* lhs, Expr* rhs)
     logger::debug("Resulting " + getTypeStr(newExpr->type) + ": " + std::to_string(newExpr->intVal) + " = " + std::to_string(lhs->intVal) + " < " + std::to_string(rhs->intVal));
   }
   else
-  {
-    newExpr->reg = Register::allocate();
-    loadImmediate(lhs);
-    loadImmediate(rhs);
-    logger::code(getArithInstStr("slt", newExpr, lhs, rhs));
-  }
+    buildBinary(newExpr, ir::IR_SLT, lhs, rhs);
 
   delete lhs;
   delete rhs;
@@ -713,12 +1221,7 @@ Expr* lteExpr(Expr* lhs, Expr* rhs)
     logger::debug("Resulting " + getTypeStr(newExpr->type) + ": " + std::to_string(newExpr->intVal) + " = " + std::to_string(lhs->intVal) + " <= " + std::to_string(rhs->intVal));
   }
   else
-  {
-    newExpr->reg = Register::allocate();
-    loadImmediate(lhs);
-    loadImmediate(rhs);
-    logger::code(getArithInstStr("sle", newExpr, lhs, rhs));
-  }
+    buildBinary(newExpr, ir::IR_SLE, lhs, rhs);
 
   delete lhs;
   delete rhs;
@@ -755,17 +1258,11 @@ Expr* modExpr(Expr* lhs, Expr* rhs)
   {
     if (rhs->intVal == 0)
       logger::compileError("Cannot divide by zero");
-    newExpr->intVal = lhs->intVal % rhs->intVal;
+    newExpr->intVal = foldConstants(ir::IR_MOD, lhs->intVal, rhs->intVal);
     logger::debug("Resulting " + getTypeStr(newExpr->type) + ": " + std::to_string(newExpr->intVal) + " = " + std::to_string(lhs->intVal) + " % " + std::to_string(rhs->intVal));
   }
   else
-  {
-    newExpr->reg = Register::allocate();
-    loadImmediate(lhs);
-    loadImmediate(rhs);
-    logger::code(getArithInstStr("div", lhs, rhs));
-    logger::code(getInstStr("mfhi", newExpr->reg->getName()));
-  }
+    buildBinary(newExpr, ir::IR_MOD, lhs, rhs);
 
   delete lhs;
   delete rhs;
@@ -785,17 +1282,11 @@ Expr* multExpr(Expr* lhs, Expr* rhs)
 
   if (newExpr->isConst)
   {
-    newExpr->intVal = lhs->intVal * rhs->intVal;
+    newExpr->intVal = foldConstants(ir::IR_MUL, lhs->intVal, rhs->intVal);
     logger::debug("Resulting " + getTypeStr(newExpr->type) + ": " + std::to_string(newExpr->intVal) + " = " + std::to_string(lhs->intVal) + " * " + std::to_string(rhs->intVal));
   }
   else
-  {
-    newExpr->reg = Register::allocate();
-    loadImmediate(lhs);
-    loadImmediate(rhs);
-    logger::code(getArithInstStr("mult", lhs, rhs));
-    logger::code(getInstStr("mflo", newExpr->reg->getName()));
-  }
+    buildBinary(newExpr, ir::IR_MUL, lhs, rhs);
 
   delete lhs;
   delete rhs;
@@ -809,9 +1300,9 @@ Expr* negExpr(Expr* expr)
   checkType(expr);
 
   if (expr->isConst)
-    expr->intVal = -expr->intVal;
+    expr->intVal = foldConstants(ir::IR_SUB, 0, expr->intVal);
   else
-    logger::code(getInstStr("sub", expr->reg->getName(), "$zero", expr->reg->getName()), "Negate");
+    setResult(expr, emitBinary(ir::IR_SUB, ir::Operand::constant(0), operand(expr), "Negate"));
   return expr;
 }
 
@@ -831,12 +1322,7 @@ Expr* neqExpr(Expr* lhs, Expr* rhs)
     logger::debug("Resulting " + getTypeStr(newExpr->type) + ": " + std::to_string(newExpr->intVal) + " = " + std::to_string(lhs->intVal) + " != " + std::to_string(rhs->intVal));
   }
   else
-  {
-    newExpr->reg = Register::allocate();
-    loadImmediate(lhs);
-    loadImmediate(rhs);
-    logger::code(getArithInstStr("sne", newExpr, lhs, rhs));
-  }
+    buildBinary(newExpr, ir::IR_SNE, lhs, rhs);
 
   delete lhs;
   delete rhs;
@@ -856,12 +1342,17 @@ Expr* notExpr(Expr* expr)
     else
       expr->intVal = ~expr->intVal;
   }
+  else if (expr->negated >= 0)
+  {
+    // ~~x is x
+    setResult(expr, expr->negated);
+  }
   else
   {
-    if (expr->type == TYPE_BOOL)
-      logger::code(getInstStr("xori", expr->reg->getName(), expr->reg->getName(), "1"), "Negate");
-    else
-      logger::code(getInstStr("xori", expr->reg->getName(), expr->reg->getName(), "-1"), "Negate");
+    int value = expr->reg;
+    int mask = expr->type == TYPE_BOOL ? 1 : -1;
+    setResult(expr, emitBinary(ir::IR_XOR, operand(expr), ir::Operand::constant(mask), "Negate"));
+    expr->negated = value;
   }
 
   return expr;
@@ -885,13 +1376,21 @@ Expr* orExpr(Expr* lhs, Expr* rhs)
     newExpr->intVal = lhs->intVal || rhs->intVal;
     logger::debug("Resulting " + getTypeStr(newExpr->type) + ": " + std::to_string(newExpr->intVal) + " = " + std::to_string(lhs->intVal) + " || " + std::to_string(rhs->intVal));
   }
+  else if (lhs->isConst || rhs->isConst)
+  {
+    // true | x is true and false | x is x
+    auto value = lhs->isConst ? rhs : lhs;
+    auto other = lhs->isConst ? lhs : rhs;
+    if (other->intVal != 0)
+      setConst(newExpr, 1);
+    else
+      setResult(newExpr, toBoolean(value).value);
+  }
+  else if (isSameValue(lhs, rhs))
+    setResult(newExpr, toBoolean(lhs).value);
   else
   {
-    newExpr->reg = Register::allocate();
-    loadImmediate(lhs);
-    loadImmediate(rhs);
-    logger::code(getArithInstStr("or", newExpr, lhs, rhs));
-    logger::code(getInstStr("sne", newExpr->reg->getName(), newExpr->reg->getName(), "$zero"));
+    newExpr->reg = emitBinary(ir::IR_OR, toBoolean(lhs), toBoolean(rhs));
   }
 
   delete lhs;
@@ -919,9 +1418,9 @@ Expr* predExpr(Expr* expr)
   if (expr->type == TYPE_BOOL)
     expr = notExpr(expr); 
   else if (expr->isConst)
-    expr->intVal--;
+    expr->intVal = foldConstants(ir::IR_SUB, expr->intVal, 1);
   else
-    logger::code(getInstStr("addi", expr->reg->getName(), expr->reg->getName(), "-1"), "Decrement");
+    buildAddConst(expr, expr, -1);
 
   return expr;
 }
@@ -952,16 +1451,11 @@ Expr* subExpr(Expr* lhs, Expr* rhs)
 
   if (newExpr->isConst)
   {
-    newExpr->intVal = lhs->intVal - rhs->intVal;
+    newExpr->intVal = foldConstants(ir::IR_SUB, lhs->intVal, rhs->intVal);
     logger::debug("Resulting " + getTypeStr(newExpr->type) + ": " + std::to_string(newExpr->intVal) + " = " + std::to_string(lhs->intVal) + " - " + std::to_string(rhs->intVal));
   }
   else
-  {
-    newExpr->reg = Register::allocate();
-    loadImmediate(lhs);
-    loadImmediate(rhs);
-    logger::code(getArithInstStr("sub", newExpr, lhs, rhs));
-  }
+    buildBinary(newExpr, ir::IR_SUB, lhs, rhs);
 
   delete lhs;
   delete rhs;
@@ -977,9 +1471,9 @@ Expr* succExpr(Expr* expr)
   if (expr->type == TYPE_BOOL)
     expr = notExpr(expr);
   else if (expr->isConst)
-    expr->intVal++;
+    expr->intVal = foldConstants(ir::IR_ADD, expr->intVal, 1);
   else
-    logger::code(getInstStr("addi", expr->reg->getName(), expr->reg->getName(), "1"), "Increment");
+    buildAddConst(expr, expr, 1);
 
   return expr;
 }
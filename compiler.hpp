@@ -1,9 +1,6 @@
 #ifndef COMPILER_HPP
 #define COMPILER_HPP
 
-// Project Includes
-#include "register.hpp"
-
 // Standard Includes
 #include <string>
 
@@ -20,7 +17,14 @@ struct Expr
 {
   Type type;
   bool isConst;
-  Reg reg;
+  int reg = -1; // Virtual register holding the value, -1 for constants
+
+  // What is known about how reg was computed, for the algebraic simplifications
+  int var = -1;     // $gp offset when the value is a variable read as is
+  int calls = 0;    // Calls emitted before var was read
+  int base = -1;    // Register the value was computed from by adding addend
+  int addend = 0;
+  int negated = -1; // Register whose negation the value is
   int intVal;
   std::string strVal;
   std::string name;
@@ -34,9 +38,21 @@ void addConst(const std::string& id, Expr* expr);
 void addId(const std::string& id);
 void addVars(int type);
 
+void procBegin(const std::string& name);
+void addParams(int isRef, int type);
+void procDecl(int type);
+void procForward();
+void procEnd();
+
 void assignExpr(Expr* lhs, Expr* rhs);
 void readExpr(Expr* expr);
 void writeExpr(Expr* expr);
+void stop();
+void returnStmt(Expr* expr);
+
+void callBegin(const std::string& name);
+void addArg(Expr* expr);
+void callProc();
 
 void forInit(const std::string& lhs, Expr* rhs);
 int forDownTo(Expr* expr);
@@ -59,6 +75,7 @@ int simpleType(const std::string& id);
 
 Expr* addExpr(Expr* lhs, Expr* rhs);
 Expr* andExpr(Expr* lhs, Expr* rhs);
+Expr* callExpr();
 Expr* charExpr(int expr);
 Expr* chrExpr(Expr* expr);
 Expr* divExpr(Expr* lhs, Expr* rhs);
@@ -0,0 +1,173 @@
+// Primary Include
+#include "passes.hpp"
+
+// Project Includes
+#include "analysis.hpp"
+#include "ir.hpp"
+
+// Standard Includes
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+namespace
+{
+  // Opcode and operands of a pure instruction, loads use their $gp offset as the operand
+  using Key = std::tuple<int, int, int, int, int>;
+
+  class ValueNumbering
+  {
+  public:
+    ValueNumbering(ir::Function& func) : m_func(func), m_defs(func.getVRegCount(), 0), m_replacement(func.getVRegCount(), -1)
+    {
+      for (auto&& id : func.getLayout())
+      {
+        for (auto&& instr : func.getBlock(id).instrs)
+        {
+          if (instr.dst >= 0)
+            ++m_defs[instr.dst];
+        }
+      }
+    }
+
+    void run()
+    {
+      auto idom = analysis::computeDominators(m_func);
+      m_children.assign(m_func.getBlockCount(), {});
+      for (auto&& id : m_func.getLayout())
+      {
+        if (idom[id] >= 0 && idom[id] != id)
+          m_children[idom[id]].push_back(id);
+      }
+      visit(m_func.getLayout().front());
+
+      for (auto&& id : m_func.getLayout())
+      {
+        auto& instrs = m_func.getBlock(id).instrs;
+        for (auto&& instr : instrs)
+        {
+          for (auto&& src : instr.src)
+          {
+            if (src.isReg() && m_replacement[src.value] >= 0)
+              src.value = m_replacement[src.value];
+          }
+        }
+        instrs.erase(std::remove_if(instrs.begin(), instrs.end(), [&](const ir::Instr& instr)
+        {
+          return instr.dst >= 0 && m_replacement[instr.dst] >= 0;
+        }), instrs.end());
+      }
+    }
+
+  private:
+    bool isFixed(const ir::Operand& operand) const
+    {
+      return !operand.isReg() || m_defs[operand.value] == 1;
+    }
+
+    // Commutative operations and mirrored comparisons share a key
+    static Key getKey(const ir::Instr& instr)
+    {
+      if (instr.op == ir::IR_LOAD)
+        return Key(instr.op, instr.imm, 0, 0, 0);
+
+      auto op = instr.op;
+      auto lhs = instr.src[0];
+      auto rhs = instr.src[1];
+      bool swappable = ir::isCommutative(op) || ir::getSwapped(op) != op;
+      if (swappable && std::make_pair(rhs.kind, rhs.value) < std::make_pair(lhs.kind, lhs.value))
+      {
+        std::swap(lhs, rhs);
+        op = ir::getSwapped(op);
+      }
+      return Key(op, lhs.kind, lhs.value, rhs.kind, rhs.value);
+    }
+
+    static bool isCandidate(const ir::Instr& instr)
+    {
+      return instr.dst >= 0 && (instr.op <= ir::IR_SGE || instr.op == ir::IR_LOAD);
+    }
+
+    // Values computed with registers that keep their value everywhere are
+    // available in every dominated block; loads and values of registers that
+    // are redefined, like loop counters, only until a kill in the same block
+    void visit(int id)
+    {
+      std::vector<Key> scoped;
+      std::map<Key, int> local;
+      for (auto&& instr : m_func.getBlock(id).instrs)
+      {
+        if (instr.op == ir::IR_STORE)
+          local.erase(Key(ir::IR_LOAD, instr.imm, 0, 0, 0));
+        if (instr.op == ir::IR_CALL)
+        {
+          for (auto it = local.begin(); it != local.end();)
+          {
+            if (std::get<0>(it->first) == ir::IR_LOAD)
+              it = local.erase(it);
+            else
+              ++it;
+          }
+        }
+        if (instr.dst >= 0)
+        {
+          for (auto it = local.begin(); it != local.end();)
+          {
+            bool reads = std::get<1>(it->first) == ir::OPND_REG && std::get<2>(it->first) == instr.dst;
+            reads = reads || (std::get<3>(it->first) == ir::OPND_REG && std::get<4>(it->first) == instr.dst);
+            if (it->second == instr.dst || (std::get<0>(it->first) != ir::IR_LOAD && reads))
+              it = local.erase(it);
+            else
+              ++it;
+          }
+        }
+        if (!isCandidate(instr))
+          continue;
+
+        auto key = getKey(instr);
+        bool global = instr.op != ir::IR_LOAD && m_defs[instr.dst] == 1 && isFixed(instr.src[0]) && isFixed(instr.src[1]);
+        auto found = m_available.find(key);
+        int previous = found != m_available.end() ? found->second : local.count(key) ? local[key] : -1;
+        if (previous >= 0 && previous != instr.dst)
+        {
+          passes::count("cse");
+          if (m_defs[instr.dst] == 1 && m_defs[previous] == 1)
+          {
+            m_replacement[instr.dst] = previous;
+            continue;
+          }
+          int comment = instr.comment;
+          instr = ir::copy(instr.dst, ir::Operand::reg(previous));
+          instr.comment = comment;
+          continue;
+        }
+
+        if (global)
+        {
+          m_available[key] = instr.dst;
+          scoped.push_back(key);
+        }
+        else if (m_defs[instr.dst] == 1 || instr.op == ir::IR_LOAD)
+          local[key] = instr.dst;
+      }
+
+      for (auto&& child : m_children[id])
+        visit(child);
+      for (auto&& key : scoped)
+        m_available.erase(key);
+    }
+
+    ir::Function& m_func;
+    std::vector<int> m_defs;
+    std::vector<int> m_replacement; // Redundant register to the register computing its value first
+    std::vector<std::vector<int>> m_children; // Dominator tree
+    std::map<Key, int> m_available;
+  };
+}
+
+// Reuses the result of an earlier identical operation, found by walking the
+// dominator tree. Stores to a variable kill its loads, calls kill all loads.
+void passes::eliminateCommonSubexpressions(ir::Function& func)
+{
+  ValueNumbering(func).run();
+}
@@ -0,0 +1,40 @@
+// Primary Include
+#include "passes.hpp"
+
+// Project Includes
+#include "ir.hpp"
+
+// Standard Includes
+#include <algorithm>
+
+// Removes instructions without side effects whose result is never read. A
+// register with no uses anywhere has only dead definitions, so a use count
+// per register is enough to find them; removing one may make its operands
+// dead in turn.
+void passes::deadCode(ir::Function& func)
+{
+  auto uses = ir::countUses(func);
+
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (auto&& id : func.getLayout())
+    {
+      auto& instrs = func.getBlock(id).instrs;
+      auto end = std::remove_if(instrs.begin(), instrs.end(), [&](const ir::Instr& instr)
+      {
+        if (ir::hasSideEffects(instr) || instr.dst < 0 || uses[instr.dst] > 0)
+          return false;
+        for (auto&& src : instr.src)
+        {
+          if (src.isReg())
+            --uses[src.value];
+        }
+        changed = true;
+        return true;
+      });
+      instrs.erase(end, instrs.end());
+    }
+  }
+}
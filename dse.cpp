@@ -0,0 +1,104 @@
+// Primary Include
+#include "passes.hpp"
+
+// Project Includes
+#include "ir.hpp"
+
+// Standard Includes
+#include <set>
+
+namespace
+{
+  // $gp offsets whose current value may still be loaded
+  using Slots = std::set<int>;
+
+  // Every variable the function refers to, which callers and callees may read
+  Slots findSlots(const ir::Function& func)
+  {
+    Slots slots;
+    for (auto&& id : func.getLayout())
+    {
+      for (auto&& instr : func.getBlock(id).instrs)
+      {
+        if (instr.op == ir::IR_LOAD || instr.op == ir::IR_STORE)
+          slots.insert(instr.imm);
+      }
+    }
+    return slots;
+  }
+
+  void transfer(Slots& live, const ir::Instr& instr, const Slots& all)
+  {
+    if (instr.op == ir::IR_STORE)
+      live.erase(instr.imm);
+    else if (instr.op == ir::IR_LOAD)
+      live.insert(instr.imm);
+    else if (instr.op == ir::IR_CALL)
+      live = all;
+  }
+
+  // Backward may dataflow: a slot is live on exit from a block when some
+  // successor may load it before storing it. Nothing is live when the program
+  // exits, everything when a function returns.
+  std::vector<Slots> computeLiveOut(const ir::Function& func, const Slots& all)
+  {
+    std::vector<Slots> in(func.getBlockCount());
+    std::vector<Slots> out(func.getBlockCount());
+    bool changed = true;
+    while (changed)
+    {
+      changed = false;
+      for (auto it = func.getLayout().rbegin(); it != func.getLayout().rend(); ++it)
+      {
+        const auto& block = func.getBlock(*it);
+        Slots live;
+        if (block.instrs.back().op == ir::IR_RETURN)
+          live = all;
+        for (auto&& succ : ir::getSuccessors(block))
+          live.insert(in[succ].begin(), in[succ].end());
+        out[*it] = live;
+
+        for (auto instr = block.instrs.rbegin(); instr != block.instrs.rend(); ++instr)
+          transfer(live, *instr, all);
+        if (live != in[*it])
+        {
+          in[*it] = std::move(live);
+          changed = true;
+        }
+      }
+    }
+    return out;
+  }
+}
+
+// Removes stores to variables that are overwritten or never loaded again on
+// every path, then the computations that only fed them
+void passes::deadStores(ir::Function& func)
+{
+  auto all = findSlots(func);
+  auto out = computeLiveOut(func, all);
+  int removed = 0;
+  for (auto&& id : func.getLayout())
+  {
+    auto& instrs = func.getBlock(id).instrs;
+    auto live = out[id];
+    std::vector<ir::Instr> kept;
+    for (auto it = instrs.rbegin(); it != instrs.rend(); ++it)
+    {
+      if (it->op == ir::IR_STORE && !live.count(it->imm))
+      {
+        ++removed;
+        continue;
+      }
+      transfer(live, *it, all);
+      kept.push_back(*it);
+    }
+    instrs.assign(kept.rbegin(), kept.rend());
+  }
+
+  if (removed > 0)
+  {
+    passes::count("dse", removed);
+    deadCode(func);
+  }
+}
@@ -0,0 +1,95 @@
+// Primary Include
+#include "passes.hpp"
+
+// Project Includes
+#include "ir.hpp"
+
+namespace
+{
+  bool isComparison(ir::Opcode op)
+  {
+    return op >= ir::IR_SEQ && op <= ir::IR_SGE;
+  }
+
+  // Index of the instruction in the block defining vreg before the terminator, -1 if none
+  int findDef(const std::vector<ir::Instr>& instrs, int vreg)
+  {
+    for (int i = static_cast<int>(instrs.size()) - 2; i >= 0; --i)
+    {
+      if (instrs[i].dst == vreg)
+        return i;
+    }
+    return -1;
+  }
+
+  bool isRedefined(const std::vector<ir::Instr>& instrs, int from, const ir::Operand& operand)
+  {
+    if (!operand.isReg())
+      return false;
+    for (int i = from + 1; i < static_cast<int>(instrs.size()); ++i)
+    {
+      if (instrs[i].dst == operand.value)
+        return true;
+    }
+    return false;
+  }
+
+  // Rewrites a branch testing a boolean against zero to test the operands the
+  // boolean was computed from, returns false when there is nothing to fuse
+  bool fuse(std::vector<ir::Instr>& instrs, const std::vector<int>& uses)
+  {
+    auto& term = instrs.back();
+    if (term.cond != ir::COND_EQ && term.cond != ir::COND_NE)
+      return false;
+    if (term.src[0].isConst() && term.src[1].isReg())
+      std::swap(term.src[0], term.src[1]);
+    if (!term.src[0].isReg() || term.src[1] != ir::Operand::constant(0))
+      return false;
+
+    int vreg = term.src[0].value;
+    int index = findDef(instrs, vreg);
+    if (index < 0 || uses[vreg] != 1)
+      return false;
+
+    auto def = instrs[index];
+    if (def.op == ir::IR_XOR && def.src[1] == ir::Operand::constant(1) && def.src[0].isReg())
+    {
+      // A negated comparison, branch on the comparison with the opposite sense
+      int inner = findDef(instrs, def.src[0].value);
+      if (inner < 0 || !isComparison(instrs[inner].op) || uses[def.src[0].value] != 1 || isRedefined(instrs, index, def.src[0]))
+        return false;
+      term.src[0] = def.src[0];
+      term.cond = ir::invert(term.cond);
+    }
+    else if (isComparison(def.op) && !isRedefined(instrs, index, def.src[0]) && !isRedefined(instrs, index, def.src[1]))
+    {
+      // bool != 0 branches when the comparison holds, bool == 0 when it does not
+      auto cond = ir::getCond(def.op);
+      term.cond = term.cond == ir::COND_NE ? cond : ir::invert(cond);
+      term.src[0] = def.src[0];
+      term.src[1] = def.src[1];
+    }
+    else
+      return false;
+
+    instrs.erase(instrs.begin() + index);
+    passes::count("fuse-branch");
+    return true;
+  }
+}
+
+// Branches on a comparison result test the compared values directly, so
+// lowering can emit one compare-and-branch instead of materializing a boolean
+void passes::fuseBranches(ir::Function& func)
+{
+  auto uses = ir::countUses(func);
+  for (auto&& id : func.getLayout())
+  {
+    auto& instrs = func.getBlock(id).instrs;
+    if (instrs.empty() || instrs.back().op != ir::IR_BRANCH)
+      continue;
+    while (fuse(instrs, uses))
+    {
+    }
+  }
+}
@@ -0,0 +1,437 @@
+// Primary Include
+#include "ir.hpp"
+
+// Project Includes
+#include "mips.hpp"
+
+// Standard Includes
+#include <algorithm>
+#include <climits>
+#include <ostream>
+
+namespace
+{
+  const char* opNames[] =
+  {
+    "add", "sub", "mul", "div", "mod",
+    "and", "or", "xor",
+    "seq", "sne", "slt", "sle", "sgt", "sge",
+    "copy",
+    "load", "store", "loadaddr", "read", "write",
+    "param", "arg", "call",
+    "jump", "branch", "switch", "return", "exit"
+  };
+
+  const char* condNames[] = { "eq", "ne", "lt", "le", "gt", "ge" };
+
+  ir::Instr makeInstr(ir::Opcode op)
+  {
+    return { op, ir::COND_EQ, -1, { ir::Operand::none(), ir::Operand::none() }, 0, { -1, -1 }, -1 };
+  }
+
+  void printOperand(std::ostream& rOs, const ir::Operand& operand)
+  {
+    if (operand.isReg())
+      rOs << "%" << operand.value;
+    else if (operand.isConst())
+      rOs << operand.value;
+  }
+}
+
+ir::Operand ir::Operand::none() { return { OPND_NONE, 0 }; }
+
+ir::Operand ir::Operand::reg(int vreg) { return { OPND_REG, vreg }; }
+
+ir::Operand ir::Operand::constant(int value) { return { OPND_CONST, value }; }
+
+ir::Function::Function(const std::string& name) : m_name(name), m_vregCount(0) {}
+
+// Generated names start with an underscore, which no source identifier can,
+// so they never collide with the label of a procedure like proc_<name>_<n>
+int ir::Function::addBlock(const std::string& name)
+{
+  int id = static_cast<int>(m_blocks.size());
+  m_blocks.push_back({ id, name.empty() ? "_" + m_name + "_" + std::to_string(id) : name, {}, {} });
+  return id;
+}
+
+ir::Block& ir::Function::getBlock(int id) { return m_blocks[id]; }
+
+const ir::Block& ir::Function::getBlock(int id) const { return m_blocks[id]; }
+
+int ir::Function::getBlockCount() const { return static_cast<int>(m_blocks.size()); }
+
+int ir::Function::getInstrCount() const
+{
+  int count = 0;
+  for (auto&& id : m_layout)
+    count += static_cast<int>(m_blocks[id].instrs.size());
+  return count;
+}
+
+std::vector<int>& ir::Function::getLayout() { return m_layout; }
+
+const std::vector<int>& ir::Function::getLayout() const { return m_layout; }
+
+const std::string& ir::Function::getName() const { return m_name; }
+
+int ir::Function::getVRegCount() const { return m_vregCount; }
+
+int ir::Function::newVReg() { return m_vregCount++; }
+
+void ir::Function::placeBlock(int id)
+{
+  m_layout.push_back(id);
+}
+
+ir::Instr ir::arg(int index, Operand src)
+{
+  auto instr = makeInstr(IR_ARG);
+  instr.src[0] = src;
+  instr.imm = index;
+  return instr;
+}
+
+ir::Instr ir::binary(Opcode op, int dst, Operand lhs, Operand rhs)
+{
+  auto instr = makeInstr(op);
+  instr.dst = dst;
+  instr.src[0] = lhs;
+  instr.src[1] = rhs;
+  return instr;
+}
+
+ir::Instr ir::branch(Cond cond, Operand lhs, Operand rhs, int ifTrue, int ifFalse)
+{
+  auto instr = makeInstr(IR_BRANCH);
+  instr.cond = cond;
+  instr.src[0] = lhs;
+  instr.src[1] = rhs;
+  instr.target[0] = ifTrue;
+  instr.target[1] = ifFalse;
+  return instr;
+}
+
+ir::Instr ir::call(int dst, int label)
+{
+  auto instr = makeInstr(IR_CALL);
+  instr.dst = dst;
+  instr.imm = label;
+  return instr;
+}
+
+ir::Instr ir::copy(int dst, Operand src)
+{
+  auto instr = makeInstr(IR_COPY);
+  instr.dst = dst;
+  instr.src[0] = src;
+  return instr;
+}
+
+ir::Instr ir::exit() { return makeInstr(IR_EXIT); }
+
+ir::Instr ir::jump(int target)
+{
+  auto instr = makeInstr(IR_JUMP);
+  instr.target[0] = target;
+  return instr;
+}
+
+ir::Instr ir::load(int dst, int offset)
+{
+  auto instr = makeInstr(IR_LOAD);
+  instr.dst = dst;
+  instr.imm = offset;
+  return instr;
+}
+
+ir::Instr ir::loadAddr(int dst, int label)
+{
+  auto instr = makeInstr(IR_LOADADDR);
+  instr.dst = dst;
+  instr.imm = label;
+  return instr;
+}
+
+ir::Instr ir::param(int dst, int index)
+{
+  auto instr = makeInstr(IR_PARAM);
+  instr.dst = dst;
+  instr.imm = index;
+  return instr;
+}
+
+ir::Instr ir::read(int dst, int service)
+{
+  auto instr = makeInstr(IR_READ);
+  instr.dst = dst;
+  instr.imm = service;
+  return instr;
+}
+
+ir::Instr ir::ret(Operand value)
+{
+  auto instr = makeInstr(IR_RETURN);
+  instr.src[0] = value;
+  return instr;
+}
+
+ir::Instr ir::store(int offset, Operand src)
+{
+  auto instr = makeInstr(IR_STORE);
+  instr.src[0] = src;
+  instr.imm = offset;
+  return instr;
+}
+
+ir::Instr ir::switchOn(Operand value, int low, int otherwise)
+{
+  auto instr = makeInstr(IR_SWITCH);
+  instr.src[0] = value;
+  instr.imm = low;
+  instr.target[0] = otherwise;
+  return instr;
+}
+
+ir::Instr ir::write(Operand src, int service)
+{
+  auto instr = makeInstr(IR_WRITE);
+  instr.src[0] = src;
+  instr.imm = service;
+  return instr;
+}
+
+bool ir::evaluate(Cond cond, int lhs, int rhs)
+{
+  switch (cond)
+  {
+  case COND_EQ: return lhs == rhs;
+  case COND_NE: return lhs != rhs;
+  case COND_LT: return lhs < rhs;
+  case COND_LE: return lhs <= rhs;
+  case COND_GT: return lhs > rhs;
+  default: return lhs >= rhs;
+  }
+}
+
+bool ir::fold(Opcode op, int lhs, int rhs, int& result)
+{
+  auto a = static_cast<unsigned>(lhs);
+  auto b = static_cast<unsigned>(rhs);
+  switch (op)
+  {
+  case IR_ADD: result = static_cast<int>(a + b); return true;
+  case IR_SUB: result = static_cast<int>(a - b); return true;
+  case IR_MUL: result = static_cast<int>(a * b); return true;
+  case IR_DIV:
+  case IR_MOD:
+    if (rhs == 0 || (lhs == INT_MIN && rhs == -1))
+      return false;
+    result = op == IR_DIV ? lhs / rhs : lhs % rhs;
+    return true;
+  case IR_AND: result = lhs & rhs; return true;
+  case IR_OR: result = lhs | rhs; return true;
+  case IR_XOR: result = lhs ^ rhs; return true;
+  case IR_SEQ:
+  case IR_SNE:
+  case IR_SLT:
+  case IR_SLE:
+  case IR_SGT:
+  case IR_SGE:
+    result = evaluate(getCond(op), lhs, rhs);
+    return true;
+  default:
+    return false;
+  }
+}
+
+ir::Cond ir::getCond(Opcode op)
+{
+  switch (op)
+  {
+  case IR_SEQ: return COND_EQ;
+  case IR_SNE: return COND_NE;
+  case IR_SLT: return COND_LT;
+  case IR_SLE: return COND_LE;
+  case IR_SGT: return COND_GT;
+  default: return COND_GE;
+  }
+}
+
+std::vector<int> ir::countUses(const Function& func)
+{
+  std::vector<int> uses(func.getVRegCount(), 0);
+  for (auto&& id : func.getLayout())
+  {
+    for (auto&& instr : func.getBlock(id).instrs)
+    {
+      for (auto&& src : instr.src)
+      {
+        if (src.isReg())
+          ++uses[src.value];
+      }
+    }
+  }
+  return uses;
+}
+
+ir::Cond ir::invert(Cond cond)
+{
+  switch (cond)
+  {
+  case COND_EQ: return COND_NE;
+  case COND_NE: return COND_EQ;
+  case COND_LT: return COND_GE;
+  case COND_LE: return COND_GT;
+  case COND_GT: return COND_LE;
+  default: return COND_LT;
+  }
+}
+
+bool ir::isCommutative(Opcode op)
+{
+  switch (op)
+  {
+  case IR_ADD:
+  case IR_MUL:
+  case IR_AND:
+  case IR_OR:
+  case IR_XOR:
+  case IR_SEQ:
+  case IR_SNE:
+    return true;
+  default:
+    return false;
+  }
+}
+
+ir::Opcode ir::getSwapped(Opcode op)
+{
+  switch (op)
+  {
+  case IR_SLT: return IR_SGT;
+  case IR_SLE: return IR_SGE;
+  case IR_SGT: return IR_SLT;
+  case IR_SGE: return IR_SLE;
+  default: return op;
+  }
+}
+
+ir::Cond ir::getSwapped(Cond cond)
+{
+  switch (cond)
+  {
+  case COND_LT: return COND_GT;
+  case COND_LE: return COND_GE;
+  case COND_GT: return COND_LT;
+  case COND_GE: return COND_LE;
+  default: return cond;
+  }
+}
+
+bool ir::hasSideEffects(const Instr& instr)
+{
+  switch (instr.op)
+  {
+  case IR_STORE:
+  case IR_READ:
+  case IR_WRITE:
+  case IR_PARAM:
+  case IR_ARG:
+  case IR_CALL:
+    return true;
+  default:
+    return isTerminator(instr.op);
+  }
+}
+
+bool ir::isTerminator(Opcode op)
+{
+  return op == IR_JUMP || op == IR_BRANCH || op == IR_SWITCH || op == IR_RETURN || op == IR_EXIT;
+}
+
+std::vector<int> ir::getSuccessors(const Block& block)
+{
+  std::vector<int> succs;
+  if (block.instrs.empty())
+    return succs;
+
+  const auto& term = block.instrs.back();
+  if (term.op == IR_JUMP)
+    succs.push_back(term.target[0]);
+  else if (term.op == IR_BRANCH)
+  {
+    succs.push_back(term.target[0]);
+    if (term.target[1] != term.target[0])
+      succs.push_back(term.target[1]);
+  }
+  else if (term.op == IR_SWITCH)
+  {
+    succs.push_back(term.target[0]);
+    for (auto&& target : block.cases)
+    {
+      if (std::find(succs.begin(), succs.end(), target) == succs.end())
+        succs.push_back(target);
+    }
+  }
+  return succs;
+}
+
+std::vector<std::vector<int>> ir::getPredecessors(const Function& func)
+{
+  std::vector<std::vector<int>> preds(func.getBlockCount());
+  for (auto&& id : func.getLayout())
+  {
+    for (auto&& succ : getSuccessors(func.getBlock(id)))
+      preds[succ].push_back(id);
+  }
+  return preds;
+}
+
+void ir::print(std::ostream& rOs, const Function& func)
+{
+  rOs << "function " << func.getName() << "\n";
+  for (auto&& id : func.getLayout())
+  {
+    const auto& block = func.getBlock(id);
+    rOs << block.name << ":\n";
+    for (auto&& instr : block.instrs)
+    {
+      rOs << "    ";
+      if (instr.dst >= 0)
+        rOs << "%" << instr.dst << " = ";
+      rOs << opNames[instr.op];
+      if (instr.op == IR_BRANCH)
+        rOs << "." << condNames[instr.cond];
+      for (auto&& src : instr.src)
+      {
+        if (src.kind != OPND_NONE)
+        {
+          rOs << " ";
+          printOperand(rOs, src);
+        }
+      }
+      switch (instr.op)
+      {
+      case IR_LOAD:
+      case IR_STORE: rOs << " [" << instr.imm << "]"; break;
+      case IR_LOADADDR:
+      case IR_CALL: rOs << " " << mips::getLabel(instr.imm); break;
+      case IR_PARAM:
+      case IR_ARG: rOs << " #" << instr.imm; break;
+      case IR_READ:
+      case IR_WRITE: rOs << " service " << instr.imm; break;
+      case IR_JUMP: rOs << " " << func.getBlock(instr.target[0]).name; break;
+      case IR_BRANCH: rOs << " " << func.getBlock(instr.target[0]).name << ", " << func.getBlock(instr.target[1]).name; break;
+      case IR_SWITCH:
+        rOs << " from " << instr.imm << " [";
+        for (std::size_t i = 0; i < block.cases.size(); ++i)
+          rOs << (i > 0 ? ", " : "") << func.getBlock(block.cases[i]).name;
+        rOs << "] else " << func.getBlock(instr.target[0]).name;
+        break;
+      default: break;
+      }
+      rOs << "\n";
+    }
+  }
+}
@@ -0,0 +1,144 @@
+#ifndef CS5300_IR_HPP
+#define CS5300_IR_HPP
+
+// Standard Includes
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace ir
+{
+  enum Opcode
+  {
+    // dst = src0 op src1, the front end only applies and/or to booleans (0 or 1)
+    IR_ADD, IR_SUB, IR_MUL, IR_DIV, IR_MOD,
+    IR_AND, IR_OR, IR_XOR,
+    IR_SEQ, IR_SNE, IR_SLT, IR_SLE, IR_SGT, IR_SGE,
+
+    // dst = src0
+    IR_COPY,
+
+    // Memory and runtime, imm holds the $gp offset, string label id or syscall code
+    IR_LOAD,      // dst = GA[imm]
+    IR_STORE,     // GA[imm] = src0
+    IR_LOADADDR,  // dst = &label(imm)
+    IR_READ,      // dst = read syscall imm
+    IR_WRITE,     // write syscall imm of src0
+
+    // Calls, imm holds the argument index or the callee's label id
+    IR_PARAM,     // dst = incoming argument imm, at the function entry
+    IR_ARG,       // outgoing argument imm = src0, just before the call
+    IR_CALL,      // dst = call label(imm), dst is -1 for procedures
+
+    // Terminators
+    IR_JUMP,      // goto target[0]
+    IR_BRANCH,    // if (src0 cond src1) goto target[0] else goto target[1]
+    IR_SWITCH,    // goto cases[src0 - imm] of the block when in range, else target[0]
+    IR_RETURN,    // return src0 if present to the caller
+    IR_EXIT
+  };
+
+  enum Cond
+  {
+    COND_EQ, COND_NE, COND_LT, COND_LE, COND_GT, COND_GE
+  };
+
+  enum OperandKind
+  {
+    OPND_NONE, OPND_REG, OPND_CONST
+  };
+
+  // Either a virtual register or a constant
+  struct Operand
+  {
+    OperandKind kind;
+    int value;
+
+    static Operand none();
+    static Operand reg(int vreg);
+    static Operand constant(int value);
+
+    bool isConst() const { return kind == OPND_CONST; }
+    bool isReg() const { return kind == OPND_REG; }
+    bool operator==(const Operand& rhs) const { return kind == rhs.kind && value == rhs.value; }
+    bool operator!=(const Operand& rhs) const { return !(*this == rhs); }
+  };
+
+  struct Instr
+  {
+    Opcode op;
+    Cond cond;
+    int dst;
+    Operand src[2];
+    int imm;
+    int target[2];
+    int comment;
+  };
+
+  struct Block
+  {
+    int id;
+    std::string name;
+    std::vector<Instr> instrs;
+    std::vector<int> cases; // Jump table of an IR_SWITCH terminator
+  };
+
+  class Function
+  {
+  public:
+    Function(const std::string& name);
+
+    int addBlock(const std::string& name = "");
+    Block& getBlock(int id);
+    const Block& getBlock(int id) const;
+    int getBlockCount() const;
+    int getInstrCount() const;
+    std::vector<int>& getLayout();
+    const std::vector<int>& getLayout() const;
+    const std::string& getName() const;
+    int getVRegCount() const;
+    int newVReg();
+    void placeBlock(int id);
+
+  private:
+    std::string m_name;
+    std::vector<Block> m_blocks;
+    std::vector<int> m_layout;
+    int m_vregCount;
+  };
+
+  Instr arg(int index, Operand src);
+  Instr binary(Opcode op, int dst, Operand lhs, Operand rhs);
+  Instr branch(Cond cond, Operand lhs, Operand rhs, int ifTrue, int ifFalse);
+  Instr call(int dst, int label);
+  Instr copy(int dst, Operand src);
+  Instr exit();
+  Instr jump(int target);
+  Instr load(int dst, int offset);
+  Instr loadAddr(int dst, int label);
+  Instr param(int dst, int index);
+  Instr read(int dst, int service);
+  Instr ret(Operand value);
+  Instr store(int offset, Operand src);
+  Instr switchOn(Operand value, int low, int otherwise);
+  Instr write(Operand src, int service);
+
+  bool evaluate(Cond cond, int lhs, int rhs);
+  // Result of a binary opcode on constants with MIPS wraparound, false when the operation would trap
+  bool fold(Opcode op, int lhs, int rhs, int& result);
+  Cond getCond(Opcode op);
+  std::vector<int> countUses(const Function& func);
+  Cond invert(Cond cond);
+  bool isCommutative(Opcode op);
+  // Opcode giving the same result with the operands exchanged, op itself if there is none
+  Opcode getSwapped(Opcode op);
+  Cond getSwapped(Cond cond);
+  bool hasSideEffects(const Instr& instr);
+  bool isTerminator(Opcode op);
+  std::vector<int> getSuccessors(const Block& block);
+  std::vector<std::vector<int>> getPredecessors(const Function& func);
+
+  void print(std::ostream& rOs, const Function& func);
+}
+
+#endif
@@ -0,0 +1,189 @@
+// Primary Include
+#include "passes.hpp"
+
+// Project Includes
+#include "analysis.hpp"
+#include "ir.hpp"
+
+// Standard Includes
+#include <algorithm>
+#include <set>
+
+namespace
+{
+  class Hoister
+  {
+  public:
+    Hoister(ir::Function& func, const analysis::Loop& loop) : m_func(func), m_loop(loop) {}
+
+    void run()
+    {
+      m_defs.assign(m_func.getVRegCount(), 0);
+      for (auto&& id : m_func.getLayout())
+      {
+        for (auto&& instr : m_func.getBlock(id).instrs)
+        {
+          if (instr.dst >= 0)
+            ++m_defs[instr.dst];
+          if (m_loop.blocks[id] && instr.op == ir::IR_STORE)
+            m_stored.insert(instr.imm);
+          if (m_loop.blocks[id] && instr.op == ir::IR_CALL)
+            m_calls = true;
+        }
+      }
+
+      std::vector<ir::Instr> hoisted;
+      bool changed = true;
+      while (changed)
+      {
+        changed = false;
+        for (auto&& id : m_func.getLayout())
+        {
+          if (!m_loop.blocks[id])
+            continue;
+
+          auto& instrs = m_func.getBlock(id).instrs;
+          for (auto it = instrs.begin(); it != instrs.end();)
+          {
+            if (isInvariant(*it, id))
+            {
+              m_hoisted.insert(it->dst);
+              hoisted.push_back(*it);
+              it = instrs.erase(it);
+              changed = true;
+            }
+            else
+              ++it;
+          }
+        }
+      }
+
+      if (!hoisted.empty())
+      {
+        auto& pre = m_func.getBlock(getPreheader()).instrs;
+        pre.insert(pre.end() - 1, hoisted.begin(), hoisted.end());
+        passes::count("licm", static_cast<int>(hoisted.size()));
+      }
+    }
+
+  private:
+    bool isInvariantOperand(const ir::Operand& operand) const
+    {
+      return !operand.isReg() || m_hoisted.count(operand.value) || !isDefinedInLoop(operand.value);
+    }
+
+    bool isDefinedInLoop(int vreg) const
+    {
+      for (auto&& id : m_func.getLayout())
+      {
+        if (!m_loop.blocks[id])
+          continue;
+        for (auto&& instr : m_func.getBlock(id).instrs)
+        {
+          if (instr.dst == vreg)
+            return true;
+        }
+      }
+      return false;
+    }
+
+    // Hoisted code runs whenever the loop is entered, even if the path through
+    // the body that computed it is not taken, so it may not trap. Additions
+    // and subtractions trap on overflow and only move out of the header,
+    // which runs whenever the loop is entered anyway.
+    bool isInvariant(const ir::Instr& instr, int block) const
+    {
+      if (instr.dst < 0 || m_defs[instr.dst] != 1 || ir::hasSideEffects(instr))
+        return false;
+
+      switch (instr.op)
+      {
+      case ir::IR_LOAD:
+        return !m_calls && !m_stored.count(instr.imm);
+      case ir::IR_LOADADDR:
+        return true;
+      case ir::IR_COPY:
+        // Reading the source directly is as cheap, mem-forward does that in the copy's block
+        return instr.src[0].isConst();
+      case ir::IR_ADD:
+      case ir::IR_SUB:
+        if (block != m_loop.header)
+          return false;
+        break;
+      case ir::IR_DIV:
+      case ir::IR_MOD:
+        if (!instr.src[1].isConst() || instr.src[1].value == 0 || instr.src[1].value == -1)
+          return false;
+        break;
+      default:
+        break;
+      }
+      return isInvariantOperand(instr.src[0]) && isInvariantOperand(instr.src[1]);
+    }
+
+    // The block entering the loop from outside, created when the header has
+    // several outside predecessors or the one it has also leads elsewhere
+    int getPreheader()
+    {
+      int header = m_loop.header;
+      auto preds = ir::getPredecessors(m_func);
+      std::vector<int> outside;
+      std::copy_if(preds[header].begin(), preds[header].end(), std::back_inserter(outside), [&](int pred)
+      {
+        return !m_loop.blocks[pred];
+      });
+      if (outside.size() == 1 && ir::getSuccessors(m_func.getBlock(outside.front())).size() == 1)
+        return outside.front();
+
+      int pre = m_func.addBlock();
+      m_func.getBlock(pre).instrs.push_back(ir::jump(header));
+      for (auto&& pred : outside)
+      {
+        auto& term = m_func.getBlock(pred).instrs.back();
+        for (auto&& target : term.target)
+        {
+          if (target == header)
+            target = pre;
+        }
+      }
+      auto& layout = m_func.getLayout();
+      layout.insert(std::find(layout.begin(), layout.end(), header), pre);
+      return pre;
+    }
+
+    ir::Function& m_func;
+    const analysis::Loop& m_loop;
+    std::vector<int> m_defs;
+    std::set<int> m_stored; // $gp offsets written in the loop
+    bool m_calls = false;   // Whether the loop calls anything, which may write any variable
+    std::set<int> m_hoisted;
+  };
+}
+
+// Moves computations whose operands do not change in a loop, including loads
+// of variables the loop never stores, into a block that runs once before the
+// loop. Inner loops go first so their invariants can move further out.
+void passes::hoistInvariants(ir::Function& func)
+{
+  std::set<int> done;
+  while (true)
+  {
+    auto loops = analysis::findLoops(func);
+    auto next = loops.end();
+    int size = 0;
+    for (auto it = loops.begin(); it != loops.end(); ++it)
+    {
+      int blocks = static_cast<int>(std::count(it->blocks.begin(), it->blocks.end(), true));
+      if (!done.count(it->header) && (next == loops.end() || blocks < size))
+      {
+        next = it;
+        size = blocks;
+      }
+    }
+    if (next == loops.end())
+      break;
+
+    done.insert(next->header);
+    Hoister(func, *next).run();
+  }
+}
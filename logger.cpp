@@ -1,22 +1,70 @@
+
 // Project Includes
 #include "logger.hpp"
 
 // Standard Includes
 #include <iostream>
 
+namespace
+{
+  bool debugEnabled = false;
+
+  // Assembly goes to stdout when the output file is "-", so diagnostics move to stderr to keep pipelines clean
+  std::ostream& diagnostics()
+  {
+    return logger::details::Logger::isStdout() ? std::cerr : std::cout;
+  }
+}
+
+// Large enough that typical programs are written with a single flush at the end
+const std::size_t logger::details::Logger::ms_bufferSize = 1 << 20;
+
 std::unique_ptr<logger::details::Logger> logger::details::Logger::m_pInstance;
 
-logger::details::Logger::Logger(const std::string& output) : m_output(output), m_lineNum(1) {}
+logger::details::Logger::Logger(std::FILE* pOutput) : m_pOutput(pOutput), m_bytesWritten(0), m_flushCount(0), m_lineNum(1)
+{
+  // The buffer below replaces stdio buffering, so every flush becomes a single write
+  if (m_pOutput)
+    std::setvbuf(m_pOutput, nullptr, _IONBF, 0);
+  m_buffer.reserve(ms_bufferSize);
+}
 
 logger::details::Logger::~Logger()
 {
-  m_output.close();
+  writeBuffer();
+  if (m_pOutput && m_pOutput != stdout)
+    std::fclose(m_pOutput);
+}
+
+void logger::details::Logger::append(const char* data, std::size_t size)
+{
+  auto& buffer = m_pInstance->m_buffer;
+  if (buffer.size() + size > ms_bufferSize)
+    m_pInstance->writeBuffer();
+  buffer.append(data, size);
 }
 
 bool logger::details::Logger::create(const std::string& output)
 {
-  m_pInstance.reset(new Logger(output));
-  return m_pInstance->m_output.is_open();
+  std::FILE* pOutput = output == "-" ? stdout : std::fopen(output.c_str(), "w");
+  m_pInstance.reset(new Logger(pOutput));
+  return m_pInstance->m_pOutput != nullptr;
+}
+
+void logger::details::Logger::flush()
+{
+  if (m_pInstance)
+    m_pInstance->writeBuffer();
+}
+
+std::size_t logger::details::Logger::getBytesWritten()
+{
+  return m_pInstance ? m_pInstance->m_bytesWritten : 0;
+}
+
+int logger::details::Logger::getFlushCount()
+{
+  return m_pInstance ? m_pInstance->m_flushCount : 0;
 }
 
 int logger::details::Logger::getLineNum()
@@ -29,9 +77,28 @@ void logger::details::Logger::incLineNum()
   m_pInstance->m_lineNum++;
 }
 
+bool logger::details::Logger::isStdout()
+{
+  return m_pInstance && m_pInstance->m_pOutput == stdout;
+}
+
 void logger::details::Logger::log(const std::string& msg)
 {
-  m_pInstance->m_output << msg << std::endl;
+  auto& buffer = m_pInstance->m_buffer;
+  if (buffer.size() + msg.size() + 1 > ms_bufferSize)
+    m_pInstance->writeBuffer();
+  buffer.append(msg);
+  buffer.push_back('\n');
+}
+
+void logger::details::Logger::writeBuffer()
+{
+  if (m_buffer.empty() || !m_pOutput)
+    return;
+
+  m_bytesWritten += std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_pOutput);
+  m_flushCount++;
+  m_buffer.clear();
 }
 
 bool logger::init(const std::string& output)
@@ -39,6 +106,26 @@ bool logger::init(const std::string& output)
   return details::Logger::create(output);
 }
 
+void logger::append(const char* data, std::size_t size)
+{
+  details::Logger::append(data, size);
+}
+
+void logger::flush()
+{
+  details::Logger::flush();
+}
+
+std::size_t logger::getBytesWritten()
+{
+  return details::Logger::getBytesWritten();
+}
+
+int logger::getFlushCount()
+{
+  return details::Logger::getFlushCount();
+}
+
 int logger::getLineNumber()
 {
   return details::Logger::getLineNum();
@@ -78,22 +165,28 @@ void logger::compileError(const std::string& msg)
 
 void logger::compileWarning(const std::string& msg)
 {
-  std::cout << "Warning: On line " << getLineNumber() << " - " << msg << std::endl;
+  diagnostics() << "Warning: On line " << getLineNumber() << " - " << msg << std::endl;
 }
 
 void logger::debug(const std::string& msg)
 {
-  details::Logger::log("\t\t\t\t\t\t\t# DEBUG: Line " + std::to_string(getLineNumber()) + ": " + msg);
+  if (debugEnabled)
+    diagnostics() << "DEBUG: Line " << getLineNumber() << ": " << msg << std::endl;
+}
+
+void logger::enableDebug(bool enable)
+{
+  debugEnabled = enable;
 }
 
 void logger::error(const std::string& msg)
 {
-  std::cout << "Error: " << msg << std::endl;
+  diagnostics() << "Error: " << msg << std::endl;
 }
 
 void logger::info(const std::string& msg)
 {
-  std::cout << msg << std::endl;
+  diagnostics() << msg << std::endl;
 }
 
 void logger::label(const std::string& label, const std::string& code)
@@ -2,7 +2,8 @@
 #define LOGGER_HPP
 
 // STD Includes
-#include <fstream>
+#include <cstddef>
+#include <cstdio>
 #include <memory>
 #include <string>
 
@@ -15,21 +16,37 @@ namespace logger
     public:
       ~Logger();
       
+      static void append(const char* data, std::size_t size);
       static bool create(const std::string& output);
+      static void flush();
+      static std::size_t getBytesWritten();
+      static int getFlushCount();
       static int getLineNum();
       static void incLineNum();
+      static bool isStdout();
       static void log(const std::string& msg = "");
 
     private:
-      Logger(const std::string& output);
+      Logger(std::FILE* pOutput);
+
+      void writeBuffer();
       
-      std::ofstream m_output;
+      static const std::size_t ms_bufferSize;
+
+      std::FILE* m_pOutput;
+      std::string m_buffer;
+      std::size_t m_bytesWritten;
+      int m_flushCount;
       int m_lineNum;
       static std::unique_ptr<Logger> m_pInstance;
     };
   }
 
   bool init(const std::string& output);
+  void append(const char* data, std::size_t size);
+  void flush();
+  std::size_t getBytesWritten();
+  int getFlushCount();
   int getLineNumber();
   void incLineNumber();
 
@@ -39,10 +56,10 @@ namespace logger
   void compileError(const std::string& msg);
   void compileWarning(const std::string& msg);
   void debug(const std::string& msg);
+  void enableDebug(bool enable);
   void error(const std::string& msg);
   void info(const std::string& msg);
   void label(const std::string& label, const std::string& code = "");
 }
 
 #endif
-
@@ -0,0 +1,90 @@
+// Primary Include
+#include "passes.hpp"
+
+// Project Includes
+#include "ir.hpp"
+
+// Standard Includes
+#include <algorithm>
+#include <map>
+
+namespace
+{
+  // Largest loop test, not counting the branch, worth duplicating at the latch
+  const int MAX_HEADER_SIZE = 12;
+
+  // A header qualifies when it ends in a branch and the values it computes are
+  // only read inside it, so the copy can use fresh virtual registers
+  bool canRotate(const ir::Function& func, int header, const std::vector<int>& uses)
+  {
+    const auto& instrs = func.getBlock(header).instrs;
+    if (instrs.empty() || instrs.back().op != ir::IR_BRANCH || static_cast<int>(instrs.size()) - 1 > MAX_HEADER_SIZE)
+      return false;
+
+    std::map<int, int> local;
+    for (auto&& instr : instrs)
+    {
+      for (auto&& src : instr.src)
+      {
+        if (src.isReg())
+          ++local[src.value];
+      }
+    }
+    for (auto&& instr : instrs)
+    {
+      if (instr.dst >= 0 && local[instr.dst] != uses[instr.dst])
+        return false;
+    }
+    return true;
+  }
+
+  // Replaces the jump ending latch with a copy of the header
+  void duplicateHeader(ir::Function& func, int latch, int header)
+  {
+    std::map<int, int> renamed;
+    std::vector<ir::Instr> copy = func.getBlock(header).instrs;
+    for (auto&& instr : copy)
+    {
+      for (auto&& src : instr.src)
+      {
+        if (src.isReg() && renamed.count(src.value))
+          src.value = renamed[src.value];
+      }
+      if (instr.dst >= 0)
+      {
+        renamed[instr.dst] = func.newVReg();
+        instr.dst = renamed[instr.dst];
+      }
+    }
+
+    auto& instrs = func.getBlock(latch).instrs;
+    instrs.pop_back();
+    instrs.insert(instrs.end(), copy.begin(), copy.end());
+  }
+}
+
+// Turns top-tested loops into a test guarding the entry and a copy of the
+// test at the latch, so an iteration runs one conditional branch back to the
+// body instead of a jump to the header followed by the header's branch.
+// Back edges are the jumps to a block at or before the jump in the layout.
+void passes::rotateLoops(ir::Function& func)
+{
+  auto uses = ir::countUses(func);
+  const auto& layout = func.getLayout();
+  for (std::size_t i = 0; i < layout.size(); ++i)
+  {
+    int latch = layout[i];
+    const auto& instrs = func.getBlock(latch).instrs;
+    if (instrs.empty() || instrs.back().op != ir::IR_JUMP)
+      continue;
+
+    int header = instrs.back().target[0];
+    auto pos = std::find(layout.begin(), layout.end(), header);
+    if (pos - layout.begin() > static_cast<std::ptrdiff_t>(i) || header == latch || !canRotate(func, header, uses))
+      continue;
+
+    duplicateHeader(func, latch, header);
+    uses = ir::countUses(func);
+    count("loop-rotate");
+  }
+}
@@ -0,0 +1,283 @@
+// Primary Include
+#include "passes.hpp"
+
+// Project Includes
+#include "ir.hpp"
+
+// Standard Includes
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <stdexcept>
+
+namespace
+{
+  // Code size budgets in IR instructions for the unrolled loop body
+  const int FULL_UNROLL_SIZE = 64;
+  const int PARTIAL_UNROLL_SIZE = 96;
+
+  // Longest trip count worth computing, longer loops are left alone
+  const long long MAX_TRIP_COUNT = 1 << 20;
+
+  int unrollFactor = 4;
+
+  // A single block loop, rotated so the counter test ends the block, whose
+  // counter starts at a constant and steps by a constant each iteration
+  struct Loop
+  {
+    int preheader;
+    int body;
+    int counter;
+    int step;
+    int start;
+    int trips;
+  };
+
+  class Unroller
+  {
+  public:
+    Unroller(ir::Function& func) : m_func(func), m_uses(ir::countUses(func)) {}
+
+    void run()
+    {
+      auto preds = ir::getPredecessors(m_func);
+      auto layout = m_func.getLayout();
+      for (auto&& id : layout)
+      {
+        Loop loop;
+        if (findLoop(id, preds, loop))
+          unroll(loop);
+      }
+    }
+
+  private:
+    bool findLoop(int id, const std::vector<std::vector<int>>& preds, Loop& loop)
+    {
+      const auto& instrs = m_func.getBlock(id).instrs;
+      if (instrs.empty() || instrs.back().op != ir::IR_BRANCH || preds[id].size() != 2)
+        return false;
+
+      const auto& term = instrs.back();
+      if ((term.target[0] == id) == (term.target[1] == id))
+        return false;
+      loop.body = id;
+      loop.preheader = preds[id][0] == id ? preds[id][1] : preds[id][0];
+      if (loop.preheader == id)
+        return false;
+
+      // The test compares the counter with a constant
+      if (term.src[0].isReg() && term.src[1].isConst())
+        loop.counter = term.src[0].value;
+      else if (term.src[1].isReg() && term.src[0].isConst())
+        loop.counter = term.src[1].value;
+      else
+        return false;
+
+      // The counter is defined once in the body, by adding a constant to itself
+      int increments = 0;
+      std::map<int, bool> defined;
+      std::map<int, int> localUses;
+      for (auto it = instrs.begin(); it != instrs.end() - 1; ++it)
+      {
+        for (auto&& src : it->src)
+        {
+          if (!src.isReg())
+            continue;
+          ++localUses[src.value];
+          if (src.value != loop.counter && !defined[src.value] && definesInBody(instrs, src.value))
+            return false;
+        }
+        if (it->dst == loop.counter)
+        {
+          if (it->op != ir::IR_ADD || it->src[0] != ir::Operand::reg(loop.counter) || !it->src[1].isConst() || it->src[1].value == 0)
+            return false;
+          loop.step = it->src[1].value;
+          ++increments;
+        }
+        else if (it->dst >= 0)
+          defined[it->dst] = true;
+      }
+      if (increments != 1)
+        return false;
+
+      // Every other value computed in the body is only read within the same iteration
+      for (auto&& def : defined)
+      {
+        if (localUses[def.first] != m_uses[def.first])
+          return false;
+      }
+
+      // The counter enters the loop as a constant set in the preheader
+      const auto& pre = m_func.getBlock(loop.preheader).instrs;
+      auto last = std::find_if(pre.rbegin(), pre.rend(), [&](const ir::Instr& instr)
+      {
+        return instr.dst == loop.counter;
+      });
+      if (last == pre.rend() || last->op != ir::IR_COPY || !last->src[0].isConst())
+        return false;
+      loop.start = last->src[0].value;
+
+      return countTrips(term, loop);
+    }
+
+    static bool definesInBody(const std::vector<ir::Instr>& instrs, int vreg)
+    {
+      return std::any_of(instrs.begin(), instrs.end(), [&](const ir::Instr& instr)
+      {
+        return instr.dst == vreg;
+      });
+    }
+
+    // Runs the counter through the test until the loop exits
+    static bool countTrips(const ir::Instr& term, Loop& loop)
+    {
+      long long value = loop.start;
+      for (long long trips = 1; trips <= MAX_TRIP_COUNT; ++trips)
+      {
+        value += loop.step;
+        if (value < INT_MIN || value > INT_MAX)
+          return false;
+        int lhs = term.src[0].isConst() ? term.src[0].value : static_cast<int>(value);
+        int rhs = term.src[1].isConst() ? term.src[1].value : static_cast<int>(value);
+        int next = ir::evaluate(term.cond, lhs, rhs) ? term.target[0] : term.target[1];
+        if (next != loop.body)
+        {
+          loop.trips = static_cast<int>(trips);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // Appends one iteration of the body with fresh registers. With a known
+    // counter value the counter is replaced by constants, operations on
+    // constants are folded and the increment disappears.
+    void copyBody(const Loop& loop, bool substitute, int& value, std::vector<ir::Instr>& out)
+    {
+      const auto& instrs = m_func.getBlock(loop.body).instrs;
+      std::map<int, int> renamed;
+      std::map<int, int> constants;
+      if (substitute)
+        constants[loop.counter] = value;
+
+      for (auto it = instrs.begin(); it != instrs.end() - 1; ++it)
+      {
+        auto instr = *it;
+        for (auto&& src : instr.src)
+        {
+          if (src.isReg() && renamed.count(src.value))
+            src.value = renamed[src.value];
+          if (src.isReg() && constants.count(src.value))
+            src = ir::Operand::constant(constants[src.value]);
+        }
+
+        if (instr.dst == loop.counter)
+        {
+          value += loop.step;
+          if (substitute)
+          {
+            constants[loop.counter] = value;
+            continue;
+          }
+        }
+        else if (instr.dst >= 0)
+        {
+          renamed[instr.dst] = m_func.newVReg();
+          instr.dst = renamed[instr.dst];
+
+          int result;
+          if (substitute && instr.op == ir::IR_COPY && instr.src[0].isConst())
+          {
+            constants[instr.dst] = instr.src[0].value;
+            continue;
+          }
+          if (substitute && instr.op <= ir::IR_SGE && instr.src[0].isConst() && instr.src[1].isConst() &&
+              ir::fold(instr.op, instr.src[0].value, instr.src[1].value, result))
+          {
+            constants[instr.dst] = result;
+            continue;
+          }
+        }
+        out.push_back(instr);
+      }
+    }
+
+    void unroll(const Loop& loop)
+    {
+      int size = static_cast<int>(m_func.getBlock(loop.body).instrs.size()) - 1;
+      const auto term = m_func.getBlock(loop.body).instrs.back();
+      int exit = term.target[0] == loop.body ? term.target[1] : term.target[0];
+
+      if (static_cast<long long>(loop.trips) * size <= FULL_UNROLL_SIZE)
+      {
+        // Straight line code with the counter left at its final value
+        std::vector<ir::Instr> instrs;
+        int value = loop.start;
+        for (int i = 0; i < loop.trips; ++i)
+          copyBody(loop, true, value, instrs);
+        instrs.push_back(ir::copy(loop.counter, ir::Operand::constant(value)));
+        instrs.push_back(ir::jump(exit));
+        instrs.back().comment = term.comment;
+        m_func.getBlock(loop.body).instrs = std::move(instrs);
+        passes::count("loop-unroll.full");
+        return;
+      }
+
+      int factor = unrollFactor;
+      while (factor > 1 && size * (factor + loop.trips % factor) > PARTIAL_UNROLL_SIZE)
+        --factor;
+      if (factor < 2 || loop.trips < factor)
+        return;
+
+      // The iterations that do not fill a whole unrolled body run first, straight line
+      int remainder = loop.trips % factor;
+      int value = loop.start;
+      if (remainder > 0)
+      {
+        int prologue = m_func.addBlock();
+        std::vector<ir::Instr> instrs;
+        for (int i = 0; i < remainder; ++i)
+          copyBody(loop, true, value, instrs);
+        instrs.push_back(ir::copy(loop.counter, ir::Operand::constant(value)));
+        instrs.push_back(ir::jump(loop.body));
+        m_func.getBlock(prologue).instrs = std::move(instrs);
+
+        auto& pre = m_func.getBlock(loop.preheader).instrs.back();
+        for (auto&& target : pre.target)
+        {
+          if (target == loop.body)
+            target = prologue;
+        }
+        auto& layout = m_func.getLayout();
+        layout.insert(std::find(layout.begin(), layout.end(), loop.body), prologue);
+      }
+
+      // The test only runs after every factor iterations, the ones in between always continue
+      std::vector<ir::Instr> instrs;
+      for (int i = 0; i < factor; ++i)
+        copyBody(loop, false, value, instrs);
+      instrs.push_back(term);
+      m_func.getBlock(loop.body).instrs = std::move(instrs);
+      passes::count("loop-unroll.partial");
+    }
+
+    ir::Function& m_func;
+    std::vector<int> m_uses;
+  };
+}
+
+void passes::setUnrollFactor(int factor)
+{
+  if (factor < 1)
+    throw std::invalid_argument("Unroll factor must be at least 1");
+  unrollFactor = factor;
+}
+
+// Replicates the body of single block loops with a compile time trip count.
+// Short loops become straight line code with the counter folded into the
+// copies; longer ones run the body unrollFactor times per test, preceded by
+// the leftover iterations.
+void passes::unrollLoops(ir::Function& func)
+{
+  Unroller(func).run();
+}
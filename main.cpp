@@ -1,11 +1,14 @@
 // Project Includes
 #include "compiler.hpp"
 #include "logger.hpp"
+#include "passes.hpp"
 
 // Standard Includes
 #include <cstdio>
 #include <cstdlib>
 #include <sstream>
+#include <string>
+#include <vector>
 
 // Boost Includes
 #include <boost/program_options.hpp>
@@ -19,8 +22,17 @@ int main (int argc, char** argv)
     po::options_description desc("Allowed options");
     desc.add_options()
       ("help,h", "produce help message")
+      ("debug,d", "print a trace of the parser actions")
       ("input,i", po::value<std::string>(), "input cpsl file")
-      ("output,o", po::value<std::string>(), "output asm file");
+      ("output,o", po::value<std::string>(), "output asm file ('-' for stdout)")
+      ("optimize,O", po::value<int>()->default_value(1), "optimization level (0, 1 or 2)")
+      ("enable-pass", po::value<std::vector<std::string>>()->composing(), "run a pass regardless of the optimization level")
+      ("disable-pass", po::value<std::vector<std::string>>()->composing(), "never run a pass")
+      ("unroll-factor", po::value<int>()->default_value(4), "copies of a loop body per iteration when partially unrolling")
+      ("list-passes", "list the optimization passes and the level that enables them")
+      ("print-ir", "print the intermediate code after the IR passes")
+      ("time-passes", "report time and instruction count change for each pass")
+      ("stats,s", "report bytes written and flush count");
 
     po::positional_options_description posOpts;
     posOpts.add("input", 1);
@@ -38,6 +50,27 @@ int main (int argc, char** argv)
       return EXIT_SUCCESS;
     }
 
+    if (vm.count("list-passes"))
+    {
+      logger::info(passes::describe());
+      return EXIT_SUCCESS;
+    }
+
+    passes::setLevel(vm["optimize"].as<int>());
+    if (vm.count("enable-pass"))
+    {
+      for (auto&& name : vm["enable-pass"].as<std::vector<std::string>>())
+        passes::enable(name);
+    }
+    if (vm.count("disable-pass"))
+    {
+      for (auto&& name : vm["disable-pass"].as<std::vector<std::string>>())
+        passes::disable(name);
+    }
+    passes::setUnrollFactor(vm["unroll-factor"].as<int>());
+    passes::enablePrintIr(vm.count("print-ir") > 0);
+    passes::enableReport(vm.count("time-passes") > 0);
+
     std::string outFile = "out.asm";
     if (vm.count("output"))
       outFile = vm["output"].as<std::string>();
@@ -46,6 +79,8 @@ int main (int argc, char** argv)
     if (vm.count("input"))
       inFile = vm["input"].as<std::string>();
 
+    logger::enableDebug(vm.count("debug") > 0);
+
     if (!logger::init(outFile))
     {
       logger::error(std::string(argv[0]) + ": Output file '" + outFile + "' cannot be opened.");
@@ -59,6 +94,10 @@ int main (int argc, char** argv)
     }
 
     startProgram();
+    passes::report();
+
+    if (vm.count("stats"))
+      logger::info("Wrote " + std::to_string(logger::getBytesWritten()) + " bytes in " + std::to_string(logger::getFlushCount()) + " flush(es)");
   }
   catch (const std::exception& e)
   {
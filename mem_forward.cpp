@@ -0,0 +1,282 @@
+// Primary Include
+#include "passes.hpp"
+
+// Project Includes
+#include "ir.hpp"
+
+// Standard Includes
+#include <algorithm>
+#include <map>
+
+namespace
+{
+  // Operand known to equal each $gp slot at a program point
+  using Values = std::map<int, ir::Operand>;
+
+  void kill(Values& values, int vreg)
+  {
+    for (auto it = values.begin(); it != values.end();)
+    {
+      if (it->second == ir::Operand::reg(vreg))
+        it = values.erase(it);
+      else
+        ++it;
+    }
+  }
+
+  // The callee of a call may read and write any variable
+  void transfer(Values& values, const ir::Instr& instr)
+  {
+    if (instr.op == ir::IR_CALL)
+      values.clear();
+    if (instr.dst >= 0)
+      kill(values, instr.dst);
+    if (instr.op == ir::IR_LOAD)
+      values[instr.imm] = ir::Operand::reg(instr.dst);
+    else if (instr.op == ir::IR_STORE)
+      values[instr.imm] = instr.src[0];
+  }
+
+  Values meet(const Values& lhs, const Values& rhs)
+  {
+    Values result;
+    for (auto&& value : lhs)
+    {
+      auto found = rhs.find(value.first);
+      if (found != rhs.end() && found->second == value.second)
+        result.insert(value);
+    }
+    return result;
+  }
+
+  // Forward must dataflow: a slot's value is known on entry to a block when
+  // every predecessor ends with the same operand for it
+  std::vector<Values> computeEntryValues(const ir::Function& func)
+  {
+    auto preds = ir::getPredecessors(func);
+    std::vector<Values> out(func.getBlockCount());
+    std::vector<bool> visited(func.getBlockCount(), false);
+    std::vector<Values> in(func.getBlockCount());
+
+    bool changed = true;
+    while (changed)
+    {
+      changed = false;
+      for (auto&& id : func.getLayout())
+      {
+        Values values;
+        bool first = true;
+        if (id != func.getLayout().front())
+        {
+          for (auto&& pred : preds[id])
+          {
+            if (!visited[pred])
+              continue;
+            values = first ? out[pred] : meet(values, out[pred]);
+            first = false;
+          }
+        }
+        in[id] = values;
+
+        for (auto&& instr : func.getBlock(id).instrs)
+          transfer(values, instr);
+        if (!visited[id] || values != out[id])
+        {
+          visited[id] = true;
+          out[id] = std::move(values);
+          changed = true;
+        }
+      }
+    }
+    return in;
+  }
+
+  // Replaces loads of known slots with copies and drops stores that write the
+  // value already there or that are overwritten before the slot is read
+  void rewriteBlock(std::vector<ir::Instr>& instrs, Values values)
+  {
+    std::vector<bool> removed(instrs.size(), false);
+    std::map<int, int> pendingStore; // Slot to the index of a store nothing has read yet
+    for (std::size_t i = 0; i < instrs.size(); ++i)
+    {
+      auto& instr = instrs[i];
+      if (instr.op == ir::IR_LOAD)
+      {
+        pendingStore.erase(instr.imm);
+        auto found = values.find(instr.imm);
+        if (found != values.end())
+        {
+          int comment = instr.comment;
+          instr = ir::copy(instr.dst, found->second);
+          instr.comment = comment;
+          passes::count("mem-forward.loads");
+        }
+      }
+      else if (instr.op == ir::IR_STORE)
+      {
+        auto found = values.find(instr.imm);
+        if (found != values.end() && found->second == instr.src[0])
+        {
+          removed[i] = true;
+          passes::count("mem-forward.stores");
+          continue;
+        }
+
+        auto pending = pendingStore.find(instr.imm);
+        if (pending != pendingStore.end())
+        {
+          removed[pending->second] = true;
+          passes::count("mem-forward.stores");
+        }
+        pendingStore[instr.imm] = static_cast<int>(i);
+      }
+      else if (instr.op == ir::IR_CALL)
+        pendingStore.clear();
+      transfer(values, instr);
+    }
+
+    std::vector<ir::Instr> kept;
+    for (std::size_t i = 0; i < instrs.size(); ++i)
+    {
+      if (!removed[i])
+        kept.push_back(instrs[i]);
+    }
+    instrs = std::move(kept);
+  }
+
+  // Uses of a copy read its source directly when neither can change in between:
+  // the copy is the only definition of its result and the source is a constant
+  // or a register with a single definition, which dominates the copy. Returns
+  // whether anything was propagated.
+  bool propagateCopies(ir::Function& func)
+  {
+    std::vector<int> defs(func.getVRegCount(), 0);
+    for (auto&& id : func.getLayout())
+    {
+      for (auto&& instr : func.getBlock(id).instrs)
+      {
+        if (instr.dst >= 0)
+          ++defs[instr.dst];
+      }
+    }
+
+    bool changed = false;
+    std::vector<ir::Operand> replacement(func.getVRegCount(), ir::Operand::none());
+    for (auto&& id : func.getLayout())
+    {
+      for (auto&& instr : func.getBlock(id).instrs)
+      {
+        if (instr.op != ir::IR_COPY || defs[instr.dst] != 1)
+          continue;
+        if (instr.src[0].isConst() || defs[instr.src[0].value] == 1)
+        {
+          replacement[instr.dst] = instr.src[0];
+          changed = true;
+        }
+      }
+    }
+
+    for (auto&& id : func.getLayout())
+    {
+      auto& instrs = func.getBlock(id).instrs;
+      for (auto&& instr : instrs)
+      {
+        for (auto&& src : instr.src)
+        {
+          // Follow chains of copies, each source defined before the copy reading it
+          while (src.isReg() && replacement[src.value].kind != ir::OPND_NONE)
+            src = replacement[src.value];
+        }
+
+        // A forwarded constant may leave an operation on constants, which becomes another copy
+        int result;
+        if (instr.op <= ir::IR_SGE && instr.src[0].isConst() && instr.src[1].isConst() &&
+            ir::fold(instr.op, instr.src[0].value, instr.src[1].value, result))
+        {
+          int comment = instr.comment;
+          instr = ir::copy(instr.dst, ir::Operand::constant(result));
+          instr.comment = comment;
+        }
+      }
+      instrs.erase(std::remove_if(instrs.begin(), instrs.end(), [&](const ir::Instr& instr)
+      {
+        return instr.op == ir::IR_COPY && replacement[instr.dst].kind != ir::OPND_NONE;
+      }), instrs.end());
+    }
+    return changed;
+  }
+
+  // Uses of a copy of a register with several definitions, like a loop
+  // counter, read the source directly when they are in the copy's block and
+  // the source is not redefined in between. The copy goes once none is left.
+  void propagateLocalCopies(ir::Function& func)
+  {
+    std::vector<int> defs(func.getVRegCount(), 0);
+    std::vector<int> uses(func.getVRegCount(), 0);
+    for (auto&& id : func.getLayout())
+    {
+      for (auto&& instr : func.getBlock(id).instrs)
+      {
+        if (instr.dst >= 0)
+          ++defs[instr.dst];
+        for (auto&& src : instr.src)
+        {
+          if (src.isReg())
+            ++uses[src.value];
+        }
+      }
+    }
+
+    for (auto&& id : func.getLayout())
+    {
+      auto& instrs = func.getBlock(id).instrs;
+      std::map<int, int> sources; // Copy to the register it still equals
+      for (auto&& instr : instrs)
+      {
+        for (auto&& src : instr.src)
+        {
+          auto found = src.isReg() ? sources.find(src.value) : sources.end();
+          if (found != sources.end())
+          {
+            --uses[src.value];
+            src.value = found->second;
+          }
+        }
+        if (instr.dst >= 0)
+        {
+          for (auto it = sources.begin(); it != sources.end();)
+          {
+            if (it->second == instr.dst)
+              it = sources.erase(it);
+            else
+              ++it;
+          }
+        }
+        if (instr.op == ir::IR_COPY && instr.src[0].isReg() && defs[instr.dst] == 1 && instr.dst != instr.src[0].value)
+          sources[instr.dst] = instr.src[0].value;
+      }
+    }
+
+    for (auto&& id : func.getLayout())
+    {
+      auto& instrs = func.getBlock(id).instrs;
+      instrs.erase(std::remove_if(instrs.begin(), instrs.end(), [&](const ir::Instr& instr)
+      {
+        return instr.op == ir::IR_COPY && instr.src[0].isReg() && defs[instr.dst] == 1 && uses[instr.dst] == 0;
+      }), instrs.end());
+    }
+  }
+}
+
+// Keeps variables in the registers that last loaded or stored them instead of
+// reading $gp again, within blocks and across blocks whose predecessors agree
+void passes::forwardMemory(ir::Function& func)
+{
+  auto in = computeEntryValues(func);
+  for (auto&& id : func.getLayout())
+    rewriteBlock(func.getBlock(id).instrs, in[id]);
+  while (propagateCopies(func))
+  {
+  }
+  propagateLocalCopies(func);
+}
@@ -0,0 +1,357 @@
+// Primary Include
+#include "mips.hpp"
+
+// Project Includes
+#include "logger.hpp"
+
+// Standard Includes
+#include <charconv>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+  enum Format
+  {
+    FMT_NONE,  // syscall
+    FMT_D,     // mflo rd
+    FMT_S,     // jr rs
+    FMT_DS,    // move rd, rs
+    FMT_ST,    // mult rs, rt
+    FMT_DST,   // add rd, rs, rt
+    FMT_DSI,   // addi rd, rs, imm
+    FMT_DI,    // li rd, imm
+    FMT_DL,    // la rd, label
+    FMT_LOAD,  // lw rd, imm(rs)
+    FMT_STORE, // sw rt, imm(rs)
+    FMT_L,     // j label
+    FMT_SL,    // bgez rs, label
+    FMT_STL,   // beq rs, rt, label
+    FMT_LABEL,
+    FMT_COMMENT,
+    FMT_DEBUG,
+    FMT_BLANK
+  };
+
+  struct OpInfo
+  {
+    const char* mnemonic;
+    Format format;
+  };
+
+  // Indexed by mips::Opcode
+  const OpInfo opTable[mips::OP_COUNT] =
+  {
+    { "add", FMT_DST }, { "addi", FMT_DSI }, { "addiu", FMT_DSI }, { "addu", FMT_DST }, { "sub", FMT_DST }, { "subu", FMT_DST },
+    { "and", FMT_DST }, { "andi", FMT_DSI }, { "or", FMT_DST }, { "ori", FMT_DSI }, { "xor", FMT_DST }, { "xori", FMT_DSI }, { "nor", FMT_DST },
+    { "sll", FMT_DSI }, { "sra", FMT_DSI }, { "srl", FMT_DSI },
+    { "slt", FMT_DST }, { "slti", FMT_DSI }, { "sltiu", FMT_DSI }, { "sltu", FMT_DST },
+    { "seq", FMT_DST }, { "sge", FMT_DST }, { "sgt", FMT_DST }, { "sle", FMT_DST }, { "sne", FMT_DST },
+    { "mult", FMT_ST }, { "div", FMT_ST }, { "mfhi", FMT_D }, { "mflo", FMT_D },
+    { "la", FMT_DL }, { "li", FMT_DI }, { "lui", FMT_DI }, { "lw", FMT_LOAD }, { "move", FMT_DS }, { "sw", FMT_STORE },
+    { "beq", FMT_STL }, { "bgez", FMT_SL }, { "bgtz", FMT_SL }, { "blez", FMT_SL }, { "bltz", FMT_SL }, { "bne", FMT_STL },
+    { "j", FMT_L }, { "jal", FMT_L }, { "jr", FMT_S }, { "syscall", FMT_NONE },
+    { "", FMT_LABEL }, { "", FMT_COMMENT }, { "", FMT_DEBUG }, { "", FMT_BLANK }
+  };
+
+  const char* regNames[mips::REG_COUNT] =
+  {
+    "$zero", "$at", "$v0", "$v1",
+    "$a0", "$a1", "$a2", "$a3",
+    "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+    "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+    "$t8", "$t9", "$k0", "$k1",
+    "$gp", "$sp", "$fp", "$ra"
+  };
+
+  std::vector<std::string> labelTable;
+  std::unordered_map<std::string, int> labelIds;
+  std::vector<std::string> commentTable;
+  std::unordered_map<std::string, int> commentIds;
+
+  int intern(std::vector<std::string>& table, std::unordered_map<std::string, int>& ids, const std::string& str)
+  {
+    auto found = ids.find(str);
+    if (found != ids.end())
+      return found->second;
+
+    int id = static_cast<int>(table.size());
+    table.push_back(str);
+    ids.emplace(str, id);
+    return id;
+  }
+
+  mips::MachineInstr makeInstr(mips::Opcode op, int rd = mips::REG_NONE, int rs = mips::REG_NONE, int rt = mips::REG_NONE, int imm = 0, int label = -1)
+  {
+    return { op, static_cast<std::int8_t>(rd), static_cast<std::int8_t>(rs), static_cast<std::int8_t>(rt), imm, label, -1 };
+  }
+
+  // Formats a line into a fixed buffer and hands it to the logger in as few pieces as possible
+  class LineWriter
+  {
+  public:
+    LineWriter() : m_pos(0), m_column(0) {}
+
+    std::size_t getColumn() const { return m_column; }
+
+    void put(char c)
+    {
+      if (m_pos == sizeof(m_buffer))
+        flush();
+      m_buffer[m_pos++] = c;
+      m_column = c == '\n' ? 0 : m_column + 1;
+    }
+
+    void put(const char* str, std::size_t size)
+    {
+      m_column += size;
+      if (m_pos + size > sizeof(m_buffer))
+      {
+        flush();
+        if (size > sizeof(m_buffer))
+        {
+          logger::append(str, size);
+          return;
+        }
+      }
+      std::memcpy(m_buffer + m_pos, str, size);
+      m_pos += size;
+    }
+
+    void put(const char* str) { put(str, std::strlen(str)); }
+    void put(const std::string& str) { put(str.data(), str.size()); }
+
+    void putInt(int value)
+    {
+      char digits[16];
+      auto result = std::to_chars(digits, digits + sizeof(digits), value);
+      put(digits, result.ptr - digits);
+    }
+
+    void putReg(int reg) { put(mips::getRegName(reg)); }
+
+    void flush()
+    {
+      logger::append(m_buffer, m_pos);
+      m_pos = 0;
+    }
+
+  private:
+    char m_buffer[128];
+    std::size_t m_pos;
+    std::size_t m_column;
+  };
+
+  void writeOperands(LineWriter& out, const mips::MachineInstr& instr, Format format)
+  {
+    switch (format)
+    {
+    case FMT_D: out.putReg(instr.rd); break;
+    case FMT_S: out.putReg(instr.rs); break;
+    case FMT_DS: out.putReg(instr.rd); out.put(", "); out.putReg(instr.rs); break;
+    case FMT_ST: out.putReg(instr.rs); out.put(", "); out.putReg(instr.rt); break;
+    case FMT_DST: out.putReg(instr.rd); out.put(", "); out.putReg(instr.rs); out.put(", "); out.putReg(instr.rt); break;
+    case FMT_DSI: out.putReg(instr.rd); out.put(", "); out.putReg(instr.rs); out.put(", "); out.putInt(instr.imm); break;
+    case FMT_DI: out.putReg(instr.rd); out.put(", "); out.putInt(instr.imm); break;
+    case FMT_DL: out.putReg(instr.rd); out.put(", "); out.put(mips::getLabel(instr.label)); break;
+    case FMT_LOAD: out.putReg(instr.rd); out.put(", "); out.putInt(instr.imm); out.put('('); out.putReg(instr.rs); out.put(')'); break;
+    case FMT_STORE: out.putReg(instr.rt); out.put(", "); out.putInt(instr.imm); out.put('('); out.putReg(instr.rs); out.put(')'); break;
+    case FMT_L: out.put(mips::getLabel(instr.label)); break;
+    case FMT_SL: out.putReg(instr.rs); out.put(", "); out.put(mips::getLabel(instr.label)); break;
+    case FMT_STL: out.putReg(instr.rs); out.put(", "); out.putReg(instr.rt); out.put(", "); out.put(mips::getLabel(instr.label)); break;
+    default: break;
+    }
+  }
+
+  void writeInstr(LineWriter& out, const mips::MachineInstr& instr)
+  {
+    const auto& info = opTable[instr.op];
+    switch (info.format)
+    {
+    case FMT_LABEL:
+      out.put(mips::getLabel(instr.label));
+      out.put(':');
+      break;
+    case FMT_COMMENT:
+      out.put("    # ");
+      out.put(mips::getComment(instr.comment));
+      break;
+    case FMT_DEBUG:
+      out.put("\t\t\t\t\t\t\t# DEBUG: ");
+      out.put(mips::getComment(instr.comment));
+      break;
+    case FMT_BLANK:
+      break;
+    default:
+    {
+      out.put("    ");
+      out.put(info.mnemonic);
+      if (info.format != FMT_NONE)
+      {
+        out.put(' ');
+        writeOperands(out, instr, info.format);
+      }
+      if (instr.comment >= 0)
+      {
+        // Keep the comment column aligned the same way logger::code does
+        if (out.getColumn() < 16)
+          out.put('\t');
+        out.put("\t# ");
+        out.put(mips::getComment(instr.comment));
+      }
+      break;
+    }
+    }
+    out.put('\n');
+  }
+}
+
+mips::Function::Function(const std::string& name) : m_name(name) {}
+
+void mips::Function::emit(const MachineInstr& instr)
+{
+  m_code.push_back(instr);
+}
+
+std::vector<mips::MachineInstr>& mips::Function::getCode() { return m_code; }
+
+const std::vector<mips::MachineInstr>& mips::Function::getCode() const { return m_code; }
+
+const std::string& mips::Function::getName() const { return m_name; }
+
+int mips::addComment(const std::string& text)
+{
+  return intern(commentTable, commentIds, text);
+}
+
+int mips::addLabel(const std::string& name)
+{
+  return intern(labelTable, labelIds, name);
+}
+
+const std::string& mips::getComment(int id) { return commentTable[id]; }
+
+const std::string& mips::getLabel(int id) { return labelTable[id]; }
+
+int mips::getDef(const MachineInstr& instr)
+{
+  switch (opTable[instr.op].format)
+  {
+  case FMT_D:
+  case FMT_DS:
+  case FMT_DST:
+  case FMT_DSI:
+  case FMT_DI:
+  case FMT_DL:
+  case FMT_LOAD:
+    return instr.rd;
+  default:
+    break;
+  }
+  if (instr.op == OP_JAL)
+    return REG_RA;
+  if (instr.op == OP_SYSCALL)
+    return REG_V0;
+  return REG_NONE;
+}
+
+bool mips::readsReg(const MachineInstr& instr, int reg)
+{
+  if (reg == REG_NONE)
+    return false;
+
+  switch (opTable[instr.op].format)
+  {
+  case FMT_NONE:
+    // syscall takes its service in $v0 and arguments in $a0 and $a1
+    return reg == REG_V0 || reg == REG_A0 || reg == REG_A1;
+  case FMT_S:
+  case FMT_DS:
+  case FMT_DSI:
+  case FMT_LOAD:
+  case FMT_SL:
+    return instr.rs == reg;
+  case FMT_ST:
+  case FMT_DST:
+  case FMT_STORE:
+  case FMT_STL:
+    return instr.rs == reg || instr.rt == reg;
+  default:
+    return false;
+  }
+}
+
+bool mips::isBlockBoundary(Opcode op)
+{
+  switch (opTable[op].format)
+  {
+  case FMT_S:
+  case FMT_L:
+  case FMT_SL:
+  case FMT_STL:
+  case FMT_LABEL:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool mips::isListingOnly(Opcode op) { return op >= OP_LABEL; }
+
+const char* mips::getMnemonic(Opcode op) { return opTable[op].mnemonic; }
+
+const char* mips::getRegName(int reg) { return regNames[reg]; }
+
+mips::MachineInstr mips::arith(Opcode op, int rd, int rs, int rt) { return makeInstr(op, rd, rs, rt); }
+
+mips::MachineInstr mips::arithImm(Opcode op, int rd, int rs, int imm) { return makeInstr(op, rd, rs, REG_NONE, imm); }
+
+mips::MachineInstr mips::blank() { return makeInstr(OP_BLANK); }
+
+mips::MachineInstr mips::branch(Opcode op, int rs, int rt, int label) { return makeInstr(op, REG_NONE, rs, rt, 0, label); }
+
+mips::MachineInstr mips::branchZero(Opcode op, int rs, int label) { return makeInstr(op, REG_NONE, rs, REG_NONE, 0, label); }
+
+mips::MachineInstr mips::comment(const std::string& text)
+{
+  auto instr = makeInstr(OP_COMMENT);
+  instr.comment = addComment(text);
+  return instr;
+}
+
+mips::MachineInstr mips::debug(const std::string& text)
+{
+  auto instr = makeInstr(OP_DEBUG);
+  instr.comment = addComment(text);
+  return instr;
+}
+
+mips::MachineInstr mips::hiLo(Opcode op, int rd) { return makeInstr(op, rd); }
+
+mips::MachineInstr mips::jump(Opcode op, int label) { return makeInstr(op, REG_NONE, REG_NONE, REG_NONE, 0, label); }
+
+mips::MachineInstr mips::jumpReg(int rs) { return makeInstr(OP_JR, REG_NONE, rs); }
+
+mips::MachineInstr mips::label(int label) { return makeInstr(OP_LABEL, REG_NONE, REG_NONE, REG_NONE, 0, label); }
+
+mips::MachineInstr mips::load(int rd, int offset, int base) { return makeInstr(OP_LW, rd, base, REG_NONE, offset); }
+
+mips::MachineInstr mips::loadAddr(int rd, int label) { return makeInstr(OP_LA, rd, REG_NONE, REG_NONE, 0, label); }
+
+mips::MachineInstr mips::loadImm(Opcode op, int rd, int imm) { return makeInstr(op, rd, REG_NONE, REG_NONE, imm); }
+
+mips::MachineInstr mips::move(int rd, int rs) { return makeInstr(OP_MOVE, rd, rs); }
+
+mips::MachineInstr mips::multDiv(Opcode op, int rs, int rt) { return makeInstr(op, REG_NONE, rs, rt); }
+
+mips::MachineInstr mips::store(int rt, int offset, int base) { return makeInstr(OP_SW, REG_NONE, base, rt, offset); }
+
+mips::MachineInstr mips::syscall() { return makeInstr(OP_SYSCALL); }
+
+void mips::write(const Function& function)
+{
+  LineWriter out;
+  for (auto&& instr : function.getCode())
+    writeInstr(out, instr);
+  out.flush();
+}
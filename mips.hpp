@@ -0,0 +1,111 @@
+#ifndef CS5300_MIPS_HPP
+#define CS5300_MIPS_HPP
+
+// Standard Includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mips
+{
+  enum RegId
+  {
+    REG_ZERO, REG_AT, REG_V0, REG_V1,
+    REG_A0, REG_A1, REG_A2, REG_A3,
+    REG_T0, REG_T1, REG_T2, REG_T3, REG_T4, REG_T5, REG_T6, REG_T7,
+    REG_S0, REG_S1, REG_S2, REG_S3, REG_S4, REG_S5, REG_S6, REG_S7,
+    REG_T8, REG_T9, REG_K0, REG_K1,
+    REG_GP, REG_SP, REG_FP, REG_RA,
+    REG_COUNT,
+    REG_NONE = -1
+  };
+
+  enum Opcode : std::uint8_t
+  {
+    // Arithmetic and logic
+    OP_ADD, OP_ADDI, OP_ADDIU, OP_ADDU, OP_SUB, OP_SUBU,
+    OP_AND, OP_ANDI, OP_OR, OP_ORI, OP_XOR, OP_XORI, OP_NOR,
+    OP_SLL, OP_SRA, OP_SRL,
+    OP_SLT, OP_SLTI, OP_SLTIU, OP_SLTU,
+    OP_SEQ, OP_SGE, OP_SGT, OP_SLE, OP_SNE,
+    OP_MULT, OP_DIV, OP_MFHI, OP_MFLO,
+
+    // Data movement
+    OP_LA, OP_LI, OP_LUI, OP_LW, OP_MOVE, OP_SW,
+
+    // Control flow
+    OP_BEQ, OP_BGEZ, OP_BGTZ, OP_BLEZ, OP_BLTZ, OP_BNE,
+    OP_J, OP_JAL, OP_JR, OP_SYSCALL,
+
+    // Pseudo entries that only affect the listing
+    OP_LABEL, OP_COMMENT, OP_DEBUG, OP_BLANK,
+
+    OP_COUNT
+  };
+
+  // A single line of assembly. Register fields hold RegId values, label and
+  // comment fields index the tables managed by addLabel() and addComment().
+  struct MachineInstr
+  {
+    Opcode op;
+    std::int8_t rd;
+    std::int8_t rs;
+    std::int8_t rt;
+    std::int32_t imm;
+    std::int32_t label;
+    std::int32_t comment;
+  };
+
+  class Function
+  {
+  public:
+    Function(const std::string& name);
+
+    void emit(const MachineInstr& instr);
+    std::vector<MachineInstr>& getCode();
+    const std::vector<MachineInstr>& getCode() const;
+    const std::string& getName() const;
+
+  private:
+    std::string m_name;
+    std::vector<MachineInstr> m_code;
+  };
+
+  int addComment(const std::string& text);
+  int addLabel(const std::string& name);
+  const std::string& getComment(int id);
+  const std::string& getLabel(int id);
+  const char* getMnemonic(Opcode op);
+
+  // Register written by an instruction, REG_NONE if it only has other effects
+  int getDef(const MachineInstr& instr);
+  bool readsReg(const MachineInstr& instr, int reg);
+  // Labels, branches and jumps end a straight-line run of instructions
+  bool isBlockBoundary(Opcode op);
+  // Labels, comments and blank lines do not execute
+  bool isListingOnly(Opcode op);
+  const char* getRegName(int reg);
+
+  MachineInstr arith(Opcode op, int rd, int rs, int rt);
+  MachineInstr arithImm(Opcode op, int rd, int rs, int imm);
+  MachineInstr blank();
+  MachineInstr branch(Opcode op, int rs, int rt, int label);
+  MachineInstr branchZero(Opcode op, int rs, int label);
+  MachineInstr comment(const std::string& text);
+  MachineInstr debug(const std::string& text);
+  MachineInstr hiLo(Opcode op, int rd);
+  MachineInstr jump(Opcode op, int label);
+  MachineInstr jumpReg(int rs);
+  MachineInstr label(int label);
+  MachineInstr load(int rd, int offset, int base);
+  MachineInstr loadAddr(int rd, int label);
+  MachineInstr loadImm(Opcode op, int rd, int imm);
+  MachineInstr move(int rd, int rs);
+  MachineInstr multDiv(Opcode op, int rs, int rt);
+  MachineInstr store(int rt, int offset, int base);
+  MachineInstr syscall();
+
+  void write(const Function& function);
+}
+
+#endif
@@ -102,6 +102,7 @@ int yylex();
 %type <expr_val> Expr
 %type <int_val> ForCondition
 %type <expr_val> LValue
+%type <int_val> OptVarRef
 %type <int_val> SimpleType
 %type <int_val> TOK_INTEGER
 %type <str_val> TOK_IDENTIFIER
@@ -121,19 +122,27 @@ ConstExpr : TOK_IDENTIFIER TOK_EQ Expr TOK_SEMICOLON { addConst($1, $3); };
 ProcOrFuncExprs : ProcOrFuncExprs ProcOrFunc | ;
 ProcOrFunc : Procedure | Function;
 
-Procedure : TOK_PROCEDURE ProcFuncCommon1 ProcFuncCommon2;
+Procedure : ProcedureHead ProcFuncCommon2;
 
-Function : TOK_FUNCTION ProcFuncCommon1 TOK_COLON Type ProcFuncCommon2;
+ProcedureHead : TOK_PROCEDURE ProcFuncCommon1 { procDecl(-1); };
 
-ProcFuncCommon1 : TOK_IDENTIFIER TOK_PARENTHESIS_L OptFormalParams TOK_PARENTHESIS_R;
+Function : FunctionHead ProcFuncCommon2;
+
+FunctionHead : TOK_FUNCTION ProcFuncCommon1 TOK_COLON Type { procDecl($4); };
+
+ProcFuncCommon1 : ProcName TOK_PARENTHESIS_L OptFormalParams TOK_PARENTHESIS_R;
+ProcName : TOK_IDENTIFIER { procBegin($1); };
 ProcFuncCommon2 : TOK_SEMICOLON ProcFuncCommon3 TOK_SEMICOLON;
-ProcFuncCommon3 : TOK_FORWARD | Body;
+ProcFuncCommon3 : TOK_FORWARD { procForward(); }
+                | Body        { procEnd(); };
 
 OptFormalParams : FormalParams | ;
 FormalParams : FormalParams TOK_SEMICOLON FormalParam | FormalParam;
-FormalParam : OptVarRef IdentList TOK_COLON Type;
+FormalParam : OptVarRef IdentList TOK_COLON Type { addParams($1, $4); };
 
-OptVarRef : TOK_VAR | TOK_REF | ;
+OptVarRef : TOK_VAR { $$ = 0; }
+          | TOK_REF { $$ = 1; }
+          |         { $$ = 0; };
 
 Body : OptConstExprs OptTypeExprs OptVarExprs Block;
 
@@ -212,9 +221,10 @@ ForInit : TOK_FOR TOK_IDENTIFIER TOK_ASSIGN Expr { forInit($2, $4); };
 ForCondition : TOK_TO Expr      { $$ = forTo($2); }
              | TOK_DOWN_TO Expr { $$ = forDownTo($2); };
 
-StopStatement : TOK_STOP { noop("Stop"); };
+StopStatement : TOK_STOP { stop(); };
 
-ReturnStatement : TOK_RETURN OptExprs { noop("Return Optional Expressions"); };
+ReturnStatement : TOK_RETURN      { returnStmt(nullptr); }
+                | TOK_RETURN Expr { returnStmt($2); };
 
 ReadStatement : TOK_READ TOK_PARENTHESIS_L ReadExprs TOK_PARENTHESIS_R;
 
@@ -226,13 +236,15 @@ WriteStatement : TOK_WRITE TOK_PARENTHESIS_L WriteExprs TOK_PARENTHESIS_R;
 WriteExprs : WriteExprs TOK_COMMA Expr { writeExpr($3); }
            | Expr                      { writeExpr($1); };
 
-ProcedureCall : TOK_IDENTIFIER TOK_PARENTHESIS_L OptExprs TOK_PARENTHESIS_R { noop("Procedure Call"); };
+ProcedureCall : CallBegin OptExprs TOK_PARENTHESIS_R { callProc(); };
+
+CallBegin : TOK_IDENTIFIER TOK_PARENTHESIS_L { callBegin($1); };
 
 OptExprs : Exprs { noop("Optional Expressions"); }
          |       { noop("No Optional Expressions"); };
          
-Exprs : Exprs TOK_COMMA Expr
-      | Expr;
+Exprs : Exprs TOK_COMMA Expr { addArg($3); }
+      | Expr                 { addArg($1); };
 
 Expr : Expr TOK_AND Expr                                           { $$ = andExpr($1, $3); }
      | Expr TOK_DIVIDE Expr                                        { $$ = divExpr($1, $3); }
@@ -249,7 +261,7 @@ Expr : Expr TOK_AND Expr                                           { $$ = andExp
      | Expr TOK_PLUS Expr                                          { $$ = addExpr($1, $3); }
      | TOK_CHAR                                                    { $$ = charExpr($1); }
      | TOK_CHR TOK_PARENTHESIS_L Expr TOK_PARENTHESIS_R            { $$ = chrExpr($3); }
-     | TOK_IDENTIFIER TOK_PARENTHESIS_L OptExprs TOK_PARENTHESIS_R { $$ = expr("Function Call"); }
+     | CallBegin OptExprs TOK_PARENTHESIS_R                        { $$ = callExpr(); }
      | LValue                                                      { $$ = loadExpr($1); }
      | TOK_INTEGER                                                 { $$ = intExpr($1); }
      | TOK_MINUS Expr %prec TOK_UNARY_MINUS                        { $$ = negExpr($2); }
@@ -0,0 +1,212 @@
+// Primary Include
+#include "passes.hpp"
+
+// Project Includes
+#include "ir.hpp"
+#include "logger.hpp"
+#include "mips.hpp"
+
+// Standard Includes
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+  struct PassInfo
+  {
+    const char* name;
+    int level; // Lowest -O level that runs the pass
+    void (*runIr)(ir::Function&);
+    void (*runMachine)(mips::Function&);
+    const char* description;
+  };
+
+  // Passes run in table order. Entries without an entry point are instruction
+  // selection choices that codegen queries through isEnabled().
+  const PassInfo pipeline[] =
+  {
+    { "fold-branches", 1, passes::foldBranches, nullptr, "turn branches on constants into jumps and drop unreachable blocks" },
+    { "dce", 1, passes::deadCode, nullptr, "remove instructions whose results are never used" },
+    { "short-circuit", 1, passes::shortCircuit, nullptr, "skip the right operand of & and | in branch conditions when the left decides" },
+    { "sccp", 1, passes::propagateConstants, nullptr, "propagate constants through registers and variables in SSA form, fold the branches they decide" },
+    { "fuse-branch", 1, passes::fuseBranches, nullptr, "branch on compared values instead of a materialized boolean" },
+    { "loop-rotate", 1, passes::rotateLoops, nullptr, "test loop conditions at the bottom behind a guard at the entry" },
+    { "simplify-cfg", 1, passes::simplifyCfg, nullptr, "thread jump chains, merge blocks linked by a single jump" },
+    { "loop-unroll", 2, passes::unrollLoops, nullptr, "replicate the body of loops with a constant trip count" },
+    { "licm", 1, passes::hoistInvariants, nullptr, "move loop invariant computations and loads out of loops" },
+    { "mem-forward", 1, passes::forwardMemory, nullptr, "reuse the register holding a variable instead of reloading it, drop redundant stores" },
+    { "cse", 1, passes::eliminateCommonSubexpressions, nullptr, "reuse the result of an identical earlier operation or load" },
+    { "switch", 1, passes::lowerSwitches, nullptr, "dispatch elseif chains on one value through a jump table or a binary search" },
+    { "dse", 1, passes::deadStores, nullptr, "remove stores to variables that are not loaded again" },
+    { "sethi-ullman", 1, passes::sethiUllman, nullptr, "evaluate the operand needing more registers first" },
+    { "peephole", 1, nullptr, passes::peephole, "rewrite redundant instruction sequences in the listing" },
+    { "prune-globals", 1, nullptr, nullptr, "leave variables the optimized program never accesses out of GA" },
+    { "imm-select", 1, nullptr, nullptr, "use immediate instruction forms for constant operands" },
+    { "mul-const", 1, nullptr, nullptr, "multiply by constants with shifts and adds when cheaper than mult" },
+    { "div-const", 1, nullptr, nullptr, "divide by constants with shifts or a magic multiplier instead of div" }
+  };
+
+  struct PassStat
+  {
+    std::string name;
+    double ms;
+    int before;
+    int after;
+  };
+
+  int level = 1;
+  bool printIr = false;
+  bool printReport = false;
+  std::set<std::string> enabled;
+  std::set<std::string> disabled;
+  std::vector<PassStat> stats;
+  std::map<std::string, int> counters;
+
+  const PassInfo* findPass(const std::string& name)
+  {
+    for (auto&& pass : pipeline)
+    {
+      if (name == pass.name)
+        return &pass;
+    }
+    return nullptr;
+  }
+
+  void checkName(const std::string& name)
+  {
+    if (findPass(name) == nullptr)
+      throw std::invalid_argument("Unknown pass '" + name + "', passes are:\n" + passes::describe());
+  }
+
+  bool isSelected(const PassInfo& pass)
+  {
+    if (disabled.count(pass.name))
+      return false;
+    return pass.level <= level || enabled.count(pass.name);
+  }
+
+  int countInstrs(const mips::Function& func)
+  {
+    return static_cast<int>(std::count_if(func.getCode().begin(), func.getCode().end(), [](const mips::MachineInstr& instr)
+    {
+      return !mips::isListingOnly(instr.op);
+    }));
+  }
+
+  template <typename Func, typename Run, typename Count>
+  void runPass(const PassInfo& pass, Func& func, Run run, Count count)
+  {
+    int before = count(func);
+    auto start = std::chrono::steady_clock::now();
+    run(func);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    stats.push_back({ pass.name, elapsed.count(), before, count(func) });
+  }
+}
+
+void passes::setLevel(int value)
+{
+  if (value < 0 || value > 2)
+    throw std::invalid_argument("Optimization level must be 0, 1 or 2");
+  level = value;
+}
+
+int passes::getLevel() { return level; }
+
+void passes::enable(const std::string& name)
+{
+  checkName(name);
+  enabled.insert(name);
+  disabled.erase(name);
+}
+
+void passes::disable(const std::string& name)
+{
+  checkName(name);
+  disabled.insert(name);
+  enabled.erase(name);
+}
+
+void passes::enablePrintIr(bool enable) { printIr = enable; }
+
+void passes::enableReport(bool enable) { printReport = enable; }
+
+std::string passes::describe()
+{
+  std::ostringstream oss;
+  for (auto&& pass : pipeline)
+  {
+    const char* kind = pass.runIr ? "ir" : pass.runMachine ? "machine" : "lowering";
+    oss << "  " << pass.name << " (-O" << pass.level << ", " << kind << "): " << pass.description << "\n";
+  }
+  return oss.str();
+}
+
+bool passes::isEnabled(const std::string& name)
+{
+  auto pass = findPass(name);
+  return pass != nullptr && isSelected(*pass);
+}
+
+void passes::count(const std::string& counter, int amount)
+{
+  counters[counter] += amount;
+}
+
+void passes::runIr(ir::Function& func)
+{
+  for (auto&& pass : pipeline)
+  {
+    if (pass.runIr && isSelected(pass))
+      runPass(pass, func, pass.runIr, [](const ir::Function& f) { return f.getInstrCount(); });
+  }
+
+  if (printIr)
+  {
+    std::ostringstream oss;
+    ir::print(oss, func);
+    logger::info(oss.str());
+  }
+}
+
+void passes::runMachine(mips::Function& func)
+{
+  for (auto&& pass : pipeline)
+  {
+    if (pass.runMachine && isSelected(pass))
+      runPass(pass, func, pass.runMachine, countInstrs);
+  }
+}
+
+void passes::report()
+{
+  if (!printReport)
+    return;
+
+  std::ostringstream oss;
+  char line[128];
+  std::snprintf(line, sizeof(line), "%-20s %10s %8s %8s %8s\n", ("Pass (-O" + std::to_string(level) + ")").c_str(), "Time (ms)", "Before", "After", "Delta");
+  oss << line;
+
+  double total = 0.0;
+  for (auto&& stat : stats)
+  {
+    std::snprintf(line, sizeof(line), "%-20s %10.3f %8d %8d %+8d\n", stat.name.c_str(), stat.ms, stat.before, stat.after, stat.after - stat.before);
+    oss << line;
+    total += stat.ms;
+  }
+  std::snprintf(line, sizeof(line), "%-20s %10.3f", "total", total);
+  oss << line;
+
+  for (auto&& counter : counters)
+  {
+    std::snprintf(line, sizeof(line), "\n%-31s %8d", counter.first.c_str(), counter.second);
+    oss << line;
+  }
+  logger::info(oss.str());
+}
@@ -0,0 +1,61 @@
+#ifndef CS5300_PASSES_HPP
+#define CS5300_PASSES_HPP
+
+// Standard Includes
+#include <string>
+#include <vector>
+
+namespace ir
+{
+  class Function;
+}
+
+namespace mips
+{
+  class Function;
+}
+
+namespace passes
+{
+  // Pipeline configuration, set from the command line before the program is compiled
+  void setLevel(int level);
+  int getLevel();
+  void enable(const std::string& name);
+  void disable(const std::string& name);
+  void enablePrintIr(bool enable);
+  void enableReport(bool enable);
+  void setUnrollFactor(int factor);
+  std::string describe();
+  bool isEnabled(const std::string& name);
+
+  // Runs every selected pass in pipeline order, IR passes before lowering and machine passes after
+  void runIr(ir::Function& func);
+  void runMachine(mips::Function& func);
+
+  // Adds to a named counter, e.g. how often a rewrite fired, shown by report()
+  void count(const std::string& counter, int amount = 1);
+
+  // Prints the per-pass timing and instruction count table collected by the run functions
+  void report();
+
+  // IR passes
+  void deadCode(ir::Function& func);
+  void deadStores(ir::Function& func);
+  void eliminateCommonSubexpressions(ir::Function& func);
+  void foldBranches(ir::Function& func);
+  void forwardMemory(ir::Function& func);
+  void fuseBranches(ir::Function& func);
+  void hoistInvariants(ir::Function& func);
+  void lowerSwitches(ir::Function& func);
+  void propagateConstants(ir::Function& func);
+  void rotateLoops(ir::Function& func);
+  void sethiUllman(ir::Function& func);
+  void shortCircuit(ir::Function& func);
+  void simplifyCfg(ir::Function& func);
+  void unrollLoops(ir::Function& func);
+
+  // Machine passes
+  void peephole(mips::Function& func);
+}
+
+#endif
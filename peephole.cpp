@@ -0,0 +1,228 @@
+// Primary Include
+#include "passes.hpp"
+
+// Project Includes
+#include "mips.hpp"
+#include "regalloc.hpp"
+
+// Standard Includes
+#include <string>
+
+namespace
+{
+  using Code = std::vector<mips::MachineInstr>;
+
+  // Print syscalls leave $v0 holding their service code
+  bool preservesV0(int service)
+  {
+    return service == 1 || service == 4 || service == 11;
+  }
+
+  bool isNote(mips::Opcode op)
+  {
+    return mips::isListingOnly(op) && op != mips::OP_LABEL;
+  }
+
+  // Index of the next line that is not a comment or blank, code.size() at the end
+  std::size_t next(const Code& code, std::size_t i)
+  {
+    do
+      ++i;
+    while (i < code.size() && isNote(code[i].op));
+    return i;
+  }
+
+  // Follows the fall-through path from an instruction. Registers are assumed
+  // live where control can leave it, except the scratch registers which
+  // lowering never keeps across instructions.
+  bool isDeadAfter(const Code& code, std::size_t i, int reg)
+  {
+    for (i = next(code, i); i < code.size(); i = next(code, i))
+    {
+      if (mips::readsReg(code[i], reg))
+        return false;
+      if (mips::getDef(code[i]) == reg)
+        return true;
+      if (code[i].op != mips::OP_LABEL && mips::isBlockBoundary(code[i].op))
+        return reg == regalloc::SCRATCH0 || reg == regalloc::SCRATCH1 || reg == regalloc::SCRATCH2;
+    }
+    return true;
+  }
+
+  // sw $x, off(base); lw $y, off(base) => sw $x, off(base); move $y, $x
+  bool storeLoad(Code& code, std::size_t i)
+  {
+    std::size_t j = next(code, i);
+    if (code[i].op != mips::OP_SW || j == code.size() || code[j].op != mips::OP_LW)
+      return false;
+    if (code[j].rs != code[i].rs || code[j].imm != code[i].imm)
+      return false;
+
+    if (code[j].rd == code[i].rt)
+      code.erase(code.begin() + j);
+    else
+    {
+      int comment = code[j].comment;
+      code[j] = mips::move(code[j].rd, code[i].rt);
+      code[j].comment = comment;
+    }
+    return true;
+  }
+
+  // lw $x, off(base); lw $y, off(base) => lw $x, off(base); move $y, $x
+  bool loadLoad(Code& code, std::size_t i)
+  {
+    std::size_t j = next(code, i);
+    if (code[i].op != mips::OP_LW || j == code.size() || code[j].op != mips::OP_LW)
+      return false;
+    if (code[j].rs != code[i].rs || code[j].imm != code[i].imm || code[i].rd == code[i].rs)
+      return false;
+
+    if (code[j].rd == code[i].rd)
+      code.erase(code.begin() + j);
+    else
+    {
+      int comment = code[j].comment;
+      code[j] = mips::move(code[j].rd, code[i].rd);
+      code[j].comment = comment;
+    }
+    return true;
+  }
+
+  // li $x, imm; move $a0, $x => li $a0, imm when $x is not read again, likewise for any instruction computing $x
+  bool foldMove(Code& code, std::size_t i)
+  {
+    std::size_t j = next(code, i);
+    if (j == code.size() || code[j].op != mips::OP_MOVE)
+      return false;
+
+    int reg = code[j].rs;
+    if (code[i].op == mips::OP_SYSCALL || code[i].op == mips::OP_JAL || mips::getDef(code[i]) != reg || reg == code[j].rd)
+      return false;
+    if (!isDeadAfter(code, j, reg))
+      return false;
+
+    code[i].rd = code[j].rd;
+    if (code[i].comment < 0)
+      code[i].comment = code[j].comment;
+    code.erase(code.begin() + j);
+    return true;
+  }
+
+  // move $x, $y followed by the only read of $x => the reader uses $y directly
+  bool forwardMove(Code& code, std::size_t i)
+  {
+    std::size_t j = next(code, i);
+    if (code[i].op != mips::OP_MOVE || j == code.size() || code[j].op == mips::OP_SYSCALL)
+      return false;
+
+    int reg = code[i].rd;
+    if (!mips::readsReg(code[j], reg) || (mips::getDef(code[j]) != reg && !isDeadAfter(code, j, reg)))
+      return false;
+
+    if (code[j].rs == reg)
+      code[j].rs = code[i].rs;
+    if (code[j].rt == reg)
+      code[j].rt = code[i].rs;
+    if (code[j].comment < 0)
+      code[j].comment = code[i].comment;
+    code.erase(code.begin() + i);
+    return true;
+  }
+
+  // li $v0, n when $v0 already holds n from an earlier li, possibly across print syscalls
+  bool repeatedService(Code& code, std::size_t i)
+  {
+    if (code[i].op != mips::OP_LI || code[i].rd != mips::REG_V0)
+      return false;
+
+    bool sawSyscall = false;
+    for (std::size_t j = i; j-- > 0;)
+    {
+      const auto& prev = code[j];
+      if (isNote(prev.op))
+        continue;
+      if (mips::isBlockBoundary(prev.op))
+        return false;
+      if (prev.op == mips::OP_SYSCALL)
+      {
+        sawSyscall = true;
+        continue;
+      }
+      if (mips::getDef(prev) != mips::REG_V0)
+        continue;
+
+      if (prev.op != mips::OP_LI || prev.imm != code[i].imm || (sawSyscall && !preservesV0(prev.imm)))
+        return false;
+      code.erase(code.begin() + i);
+      return true;
+    }
+    return false;
+  }
+
+  // j label or a branch to label when label is the next line
+  bool jumpToNext(Code& code, std::size_t i)
+  {
+    if (code[i].op == mips::OP_LABEL || code[i].op == mips::OP_JAL || code[i].label < 0 || !mips::isBlockBoundary(code[i].op))
+      return false;
+
+    for (std::size_t j = i + 1; j < code.size() && mips::isListingOnly(code[j].op); ++j)
+    {
+      if (code[j].op == mips::OP_LABEL && code[j].label == code[i].label)
+      {
+        code.erase(code.begin() + i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // move $x, $x
+  bool selfMove(Code& code, std::size_t i)
+  {
+    if (code[i].op != mips::OP_MOVE || code[i].rd != code[i].rs)
+      return false;
+    code.erase(code.begin() + i);
+    return true;
+  }
+
+  struct Rule
+  {
+    const char* name;
+    bool (*apply)(Code&, std::size_t);
+  };
+
+  // Each rule looks at the instruction at an index and the few lines around it
+  const Rule rules[] =
+  {
+    { "store-load", storeLoad },
+    { "load-load", loadLoad },
+    { "fold-move", foldMove },
+    { "forward-move", forwardMove },
+    { "repeated-service", repeatedService },
+    { "jump-to-next", jumpToNext },
+    { "self-move", selfMove }
+  };
+}
+
+// Slides over the listing applying the rewrite rules until none fires
+void passes::peephole(mips::Function& func)
+{
+  auto& code = func.getCode();
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (std::size_t i = 0; i < code.size(); ++i)
+    {
+      for (auto&& rule : rules)
+      {
+        if (i < code.size() && rule.apply(code, i))
+        {
+          count(std::string("peephole.") + rule.name);
+          changed = true;
+        }
+      }
+    }
+  }
+}
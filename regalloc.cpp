@@ -0,0 +1,192 @@
+// Primary Include
+#include "regalloc.hpp"
+
+// Project Includes
+#include "analysis.hpp"
+
+// Standard Includes
+#include <algorithm>
+#include <climits>
+#include <list>
+
+namespace
+{
+  const int allocatable[] =
+  {
+    mips::REG_T0, mips::REG_T1, mips::REG_T2, mips::REG_T3, mips::REG_T4, mips::REG_T5, mips::REG_T6, mips::REG_T7,
+    mips::REG_S0, mips::REG_S1, mips::REG_S2, mips::REG_S3, mips::REG_S4, mips::REG_S5, mips::REG_S6, mips::REG_S7
+  };
+
+  struct Interval
+  {
+    int vreg;
+    int start;
+    int end;
+    bool acrossCall; // Live across a call, which may overwrite every register but $s0-$s7
+  };
+
+  bool isCalleeSaved(int reg)
+  {
+    return reg >= mips::REG_S0 && reg <= mips::REG_S7;
+  }
+
+  // Instruction k reads its operands at position 2k and writes its result at
+  // 2k + 1, so an operand that dies at an instruction can share a register
+  // with the result.
+  std::vector<Interval> buildIntervals(const ir::Function& func, std::vector<int>& hints)
+  {
+    auto live = analysis::computeLiveness(func);
+    int vregs = func.getVRegCount();
+    std::vector<Interval> intervals(vregs);
+    for (int v = 0; v < vregs; ++v)
+      intervals[v] = { v, INT_MAX, -1, false };
+
+    auto extend = [&](int vreg, int pos)
+    {
+      intervals[vreg].start = std::min(intervals[vreg].start, pos);
+      intervals[vreg].end = std::max(intervals[vreg].end, pos);
+    };
+
+    std::vector<int> calls;
+    int k = 0;
+    for (auto&& id : func.getLayout())
+    {
+      const auto& instrs = func.getBlock(id).instrs;
+      if (instrs.empty())
+        continue;
+
+      int blockStart = 2 * k;
+      int blockEnd = 2 * (k + static_cast<int>(instrs.size())) - 1;
+      for (int v = 0; v < vregs; ++v)
+      {
+        if (live.in[id][v])
+          extend(v, blockStart);
+        if (live.out[id][v])
+          extend(v, blockEnd);
+      }
+
+      for (auto&& instr : instrs)
+      {
+        for (auto&& src : instr.src)
+        {
+          if (src.isReg())
+            extend(src.value, 2 * k);
+        }
+        if (instr.op == ir::IR_CALL)
+          calls.push_back(2 * k);
+        if (instr.dst >= 0)
+        {
+          extend(instr.dst, 2 * k + 1);
+          if (instr.op == ir::IR_COPY && instr.src[0].isReg())
+            hints[instr.dst] = instr.src[0].value;
+        }
+        ++k;
+      }
+    }
+
+    intervals.erase(std::remove_if(intervals.begin(), intervals.end(), [](const Interval& interval)
+    {
+      return interval.end < 0;
+    }), intervals.end());
+    for (auto&& interval : intervals)
+    {
+      interval.acrossCall = std::any_of(calls.begin(), calls.end(), [&](int pos)
+      {
+        return interval.start < pos && interval.end > pos + 1;
+      });
+    }
+    std::sort(intervals.begin(), intervals.end(), [](const Interval& lhs, const Interval& rhs)
+    {
+      return lhs.start < rhs.start;
+    });
+    return intervals;
+  }
+}
+
+regalloc::Allocation regalloc::allocate(const ir::Function& func)
+{
+  int vregs = func.getVRegCount();
+  Allocation result = { std::vector<int>(vregs, mips::REG_NONE), std::vector<int>(vregs, -1), 0, 0, 0 };
+
+  std::vector<int> hints(vregs, -1);
+  auto intervals = buildIntervals(func, hints);
+
+  std::vector<int> free(std::begin(allocatable), std::end(allocatable));
+  std::list<Interval> active; // Sorted by increasing end
+
+  auto spill = [&](int vreg)
+  {
+    result.regs[vreg] = mips::REG_NONE;
+    result.slots[vreg] = result.frameSize;
+    result.frameSize += 4;
+    ++result.spillCount;
+  };
+
+  for (auto&& interval : intervals)
+  {
+    while (!active.empty() && active.front().end < interval.start)
+    {
+      free.push_back(result.regs[active.front().vreg]);
+      active.pop_front();
+    }
+
+    // Values live across a call need a register the callee preserves,
+    // others take the lowest free one, $t before $s, so fewer need saving
+    auto fits = [&](int reg)
+    {
+      return !interval.acrossCall || isCalleeSaved(reg);
+    };
+
+    int reg = mips::REG_NONE;
+    if (hints[interval.vreg] >= 0)
+    {
+      // Coalesce a move by reusing the source register when it became free here
+      auto it = std::find(free.begin(), free.end(), result.regs[hints[interval.vreg]]);
+      if (it != free.end() && fits(*it))
+      {
+        reg = *it;
+        free.erase(it);
+        ++result.coalescedCount;
+      }
+    }
+    if (reg == mips::REG_NONE)
+    {
+      auto it = std::find_if(free.begin(), free.end(), fits);
+      for (auto other = it; other != free.end(); ++other)
+      {
+        if (fits(*other) && *other < *it)
+          it = other;
+      }
+      if (it != free.end())
+      {
+        reg = *it;
+        free.erase(it);
+      }
+    }
+
+    if (reg == mips::REG_NONE)
+    {
+      // Out of registers: keep whichever of the candidates ends sooner in a register
+      auto last = std::find_if(active.rbegin(), active.rend(), [&](const Interval& other)
+      {
+        return fits(result.regs[other.vreg]);
+      });
+      if (last == active.rend() || last->end <= interval.end)
+      {
+        spill(interval.vreg);
+        continue;
+      }
+      reg = result.regs[last->vreg];
+      spill(last->vreg);
+      active.erase(std::next(last).base());
+    }
+
+    result.regs[interval.vreg] = reg;
+    auto pos = std::find_if(active.begin(), active.end(), [&](const Interval& other)
+    {
+      return other.end > interval.end;
+    });
+    active.insert(pos, interval);
+  }
+  return result;
+}
@@ -0,0 +1,33 @@
+#ifndef CS5300_REGALLOC_HPP
+#define CS5300_REGALLOC_HPP
+
+// Project Includes
+#include "ir.hpp"
+#include "mips.hpp"
+
+// Standard Includes
+#include <vector>
+
+namespace regalloc
+{
+  // Never allocated, used by lowering to reload spilled values and materialize constants
+  const int SCRATCH0 = mips::REG_T8;
+  const int SCRATCH1 = mips::REG_T9;
+  // Only used inside multi-instruction sequences that keep their operands intact
+  const int SCRATCH2 = mips::REG_V1;
+
+  struct Allocation
+  {
+    std::vector<int> regs;  // Physical register of each virtual register, REG_NONE when spilled
+    std::vector<int> slots; // $sp offset of each spilled virtual register, -1 otherwise
+    int frameSize;
+    int spillCount;
+    int coalescedCount;
+  };
+
+  // Linear scan allocation over live intervals in layout order, values live
+  // across a call only get the callee saved $s registers
+  Allocation allocate(const ir::Function& func);
+}
+
+#endif
@@ -0,0 +1,453 @@
+// Primary Include
+#include "passes.hpp"
+
+// Project Includes
+#include "analysis.hpp"
+#include "ir.hpp"
+
+// Standard Includes
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <set>
+
+namespace
+{
+  enum LatticeKind
+  {
+    LAT_TOP,     // No value seen yet
+    LAT_CONST,
+    LAT_BOTTOM   // Varies at run time
+  };
+
+  struct Lattice
+  {
+    LatticeKind kind;
+    int value;
+
+    bool operator==(const Lattice& rhs) const { return kind == rhs.kind && (kind != LAT_CONST || value == rhs.value); }
+    bool operator!=(const Lattice& rhs) const { return !(*this == rhs); }
+  };
+
+  const Lattice top = { LAT_TOP, 0 };
+  const Lattice bottom = { LAT_BOTTOM, 0 };
+
+  Lattice constant(int value)
+  {
+    return { LAT_CONST, value };
+  }
+
+  Lattice meet(const Lattice& lhs, const Lattice& rhs)
+  {
+    if (lhs.kind == LAT_TOP)
+      return rhs;
+    if (rhs.kind == LAT_TOP || lhs == rhs)
+      return lhs;
+    return bottom;
+  }
+
+  struct Phi
+  {
+    int var;
+    int value;
+    std::vector<int> args; // Incoming value per predecessor, in the order of getPredecessors
+  };
+
+  // SSA names of one instruction: the values its register operands and
+  // load read, and the value it defines, -1 where there is none
+  struct InstrNames
+  {
+    int uses[2];
+    int load;
+    int def;
+  };
+
+  // Builds SSA over the registers and the $gp slots, so a variable stored
+  // once is as visible to the propagation as a register, then runs Wegman and
+  // Zadeck's conditional constant propagation over it
+  class Sccp
+  {
+  public:
+    Sccp(ir::Function& func) : m_func(func), m_vregs(func.getVRegCount()) {}
+
+    void run()
+    {
+      findVariables();
+      placePhis();
+      rename();
+      propagate();
+      rewrite();
+    }
+
+  private:
+    int getSlotVar(int offset)
+    {
+      auto found = m_slots.find(offset);
+      if (found != m_slots.end())
+        return found->second;
+      int var = m_vregs + static_cast<int>(m_slots.size());
+      m_slots[offset] = var;
+      return var;
+    }
+
+    int getDefVar(const ir::Instr& instr)
+    {
+      if (instr.op == ir::IR_STORE)
+        return getSlotVar(instr.imm);
+      return instr.dst;
+    }
+
+    int newValue(const Lattice& initial = top)
+    {
+      m_values.push_back(initial);
+      return static_cast<int>(m_values.size()) - 1;
+    }
+
+    void findVariables()
+    {
+      m_idom = analysis::computeDominators(m_func);
+      m_preds = ir::getPredecessors(m_func);
+      for (auto&& id : m_func.getLayout())
+      {
+        for (auto&& instr : m_func.getBlock(id).instrs)
+        {
+          if (instr.op == ir::IR_LOAD || instr.op == ir::IR_STORE)
+            getSlotVar(instr.imm);
+        }
+      }
+      m_defBlocks.assign(m_vregs + m_slots.size(), {});
+      for (auto&& id : m_func.getLayout())
+      {
+        for (auto&& instr : m_func.getBlock(id).instrs)
+        {
+          int var = getDefVar(instr);
+          if (var >= 0)
+            addDefBlock(var, id);
+          if (instr.op == ir::IR_CALL)
+          {
+            for (auto&& slot : m_slots)
+              addDefBlock(slot.second, id);
+          }
+        }
+      }
+    }
+
+    void addDefBlock(int var, int id)
+    {
+      if (m_defBlocks[var].empty() || m_defBlocks[var].back() != id)
+        m_defBlocks[var].push_back(id);
+    }
+
+    // Minimal SSA: a phi wherever definitions of a variable meet. Registers
+    // defined once need none, their definition dominates every use; $gp slots
+    // also have their initial value at the entry.
+    void placePhis()
+    {
+      auto frontiers = analysis::computeFrontiers(m_func, m_idom);
+      m_phis.assign(m_func.getBlockCount(), {});
+      int entry = m_func.getLayout().front();
+      for (int var = 0; var < static_cast<int>(m_defBlocks.size()); ++var)
+      {
+        auto work = m_defBlocks[var];
+        if (var < m_vregs && work.size() < 2)
+          continue;
+        if (var >= m_vregs)
+          work.push_back(entry);
+
+        std::set<int> placed;
+        std::set<int> seen(work.begin(), work.end());
+        while (!work.empty())
+        {
+          int id = work.back();
+          work.pop_back();
+          for (auto&& frontier : frontiers[id])
+          {
+            if (!placed.insert(frontier).second)
+              continue;
+            m_phis[frontier].push_back({ var, newValue(), std::vector<int>(m_preds[frontier].size(), -1) });
+            if (seen.insert(frontier).second)
+              work.push_back(frontier);
+          }
+        }
+      }
+    }
+
+    void rename()
+    {
+      m_stacks.assign(m_vregs + m_slots.size(), {});
+      // Only the main program starts with the global area zeroed, callers
+      // may have changed it before a procedure runs
+      int undefined = newValue();
+      int initial = newValue(m_func.getName() == "main" ? constant(0) : bottom);
+      for (int var = 0; var < static_cast<int>(m_stacks.size()); ++var)
+        m_stacks[var].push_back(var < m_vregs ? undefined : initial);
+
+      m_children.assign(m_func.getBlockCount(), {});
+      for (auto&& id : m_func.getLayout())
+      {
+        if (m_idom[id] >= 0 && m_idom[id] != id)
+          m_children[m_idom[id]].push_back(id);
+      }
+      m_names.assign(m_func.getBlockCount(), {});
+      renameBlock(m_func.getLayout().front());
+    }
+
+    void renameBlock(int id)
+    {
+      std::vector<int> pushed;
+      for (auto&& phi : m_phis[id])
+      {
+        m_stacks[phi.var].push_back(phi.value);
+        pushed.push_back(phi.var);
+      }
+
+      for (auto&& instr : m_func.getBlock(id).instrs)
+      {
+        InstrNames names = { { -1, -1 }, -1, -1 };
+        for (int i = 0; i < 2; ++i)
+        {
+          if (instr.src[i].isReg())
+            names.uses[i] = m_stacks[instr.src[i].value].back();
+        }
+        if (instr.op == ir::IR_LOAD)
+          names.load = m_stacks[getSlotVar(instr.imm)].back();
+
+        int var = getDefVar(instr);
+        if (var >= 0)
+        {
+          names.def = newValue();
+          m_stacks[var].push_back(names.def);
+          pushed.push_back(var);
+        }
+        if (instr.op == ir::IR_CALL)
+        {
+          // The callee may leave anything in the variables
+          for (auto&& slot : m_slots)
+          {
+            m_stacks[slot.second].push_back(newValue(bottom));
+            pushed.push_back(slot.second);
+          }
+        }
+        m_names[id].push_back(names);
+      }
+
+      for (auto&& succ : ir::getSuccessors(m_func.getBlock(id)))
+      {
+        auto index = std::find(m_preds[succ].begin(), m_preds[succ].end(), id) - m_preds[succ].begin();
+        for (auto&& phi : m_phis[succ])
+          phi.args[index] = m_stacks[phi.var].back();
+      }
+
+      for (auto&& child : m_children[id])
+        renameBlock(child);
+      for (auto&& var : pushed)
+        m_stacks[var].pop_back();
+    }
+
+    Lattice getOperand(const ir::Operand& operand, int name) const
+    {
+      if (operand.isConst())
+        return constant(operand.value);
+      return m_values[name];
+    }
+
+    Lattice evaluate(const ir::Instr& instr, const InstrNames& names) const
+    {
+      switch (instr.op)
+      {
+      case ir::IR_COPY:
+      case ir::IR_STORE:
+        return getOperand(instr.src[0], names.uses[0]);
+      case ir::IR_LOAD:
+        return m_values[names.load];
+      case ir::IR_READ:
+      case ir::IR_PARAM:
+      case ir::IR_CALL:
+      case ir::IR_LOADADDR:
+        return bottom;
+      default:
+        break;
+      }
+
+      auto lhs = getOperand(instr.src[0], names.uses[0]);
+      auto rhs = getOperand(instr.src[1], names.uses[1]);
+      if ((instr.op == ir::IR_MUL || instr.op == ir::IR_AND) && (lhs == constant(0) || rhs == constant(0)))
+        return constant(0);
+      if (lhs.kind == LAT_BOTTOM || rhs.kind == LAT_BOTTOM)
+        return bottom;
+      if (lhs.kind == LAT_TOP || rhs.kind == LAT_TOP)
+        return top;
+
+      int result;
+      if (!ir::fold(instr.op, lhs.value, rhs.value, result))
+        return bottom;
+      return constant(result);
+    }
+
+    void update(int value, const Lattice& lattice)
+    {
+      auto lowered = meet(m_values[value], lattice);
+      if (lowered == m_values[value])
+        return;
+      m_values[value] = lowered;
+      for (auto&& user : m_users[value])
+      {
+        if (m_executable[user])
+          m_work.push_back(user);
+      }
+    }
+
+    void markEdge(int from, int to)
+    {
+      if (!m_edges.insert({ from, to }).second)
+        return;
+      m_executable[to] = true;
+      m_work.push_back(to);
+    }
+
+    void findUsers()
+    {
+      m_users.assign(m_values.size(), {});
+      for (auto&& id : m_func.getLayout())
+      {
+        for (auto&& phi : m_phis[id])
+        {
+          for (auto&& arg : phi.args)
+          {
+            if (arg >= 0)
+              m_users[arg].push_back(id);
+          }
+        }
+        for (auto&& names : m_names[id])
+        {
+          for (auto&& use : { names.uses[0], names.uses[1], names.load })
+          {
+            if (use >= 0)
+              m_users[use].push_back(id);
+          }
+        }
+      }
+    }
+
+    void propagate()
+    {
+      findUsers();
+      m_executable.assign(m_func.getBlockCount(), false);
+      int entry = m_func.getLayout().front();
+      m_executable[entry] = true;
+      m_work.push_back(entry);
+      while (!m_work.empty())
+      {
+        int id = m_work.front();
+        m_work.pop_front();
+
+        for (auto&& phi : m_phis[id])
+        {
+          auto lattice = top;
+          for (std::size_t i = 0; i < phi.args.size(); ++i)
+          {
+            if (phi.args[i] >= 0 && m_edges.count({ m_preds[id][i], id }))
+              lattice = meet(lattice, m_values[phi.args[i]]);
+          }
+          update(phi.value, lattice);
+        }
+
+        const auto& instrs = m_func.getBlock(id).instrs;
+        for (std::size_t i = 0; i < instrs.size(); ++i)
+        {
+          if (m_names[id][i].def >= 0)
+            update(m_names[id][i].def, evaluate(instrs[i], m_names[id][i]));
+        }
+
+        const auto& term = instrs.back();
+        if (term.op == ir::IR_JUMP)
+          markEdge(id, term.target[0]);
+        else if (term.op == ir::IR_BRANCH)
+        {
+          // Undefined operands count as varying, both arms stay
+          auto lhs = getOperand(term.src[0], m_names[id].back().uses[0]);
+          auto rhs = getOperand(term.src[1], m_names[id].back().uses[1]);
+          if (lhs.kind == LAT_CONST && rhs.kind == LAT_CONST)
+            markEdge(id, ir::evaluate(term.cond, lhs.value, rhs.value) ? term.target[0] : term.target[1]);
+          else
+          {
+            markEdge(id, term.target[0]);
+            markEdge(id, term.target[1]);
+          }
+        }
+      }
+    }
+
+    void rewrite()
+    {
+      for (auto&& id : m_func.getLayout())
+      {
+        if (!m_executable[id])
+          continue;
+
+        auto& instrs = m_func.getBlock(id).instrs;
+        for (std::size_t i = 0; i < instrs.size(); ++i)
+        {
+          auto& instr = instrs[i];
+          const auto& names = m_names[id][i];
+          for (int s = 0; s < 2; ++s)
+          {
+            if (names.uses[s] >= 0 && m_values[names.uses[s]].kind == LAT_CONST)
+            {
+              instr.src[s] = ir::Operand::constant(m_values[names.uses[s]].value);
+              passes::count("sccp.operands");
+            }
+          }
+
+          if (instr.dst >= 0 && instr.op != ir::IR_COPY && m_values[names.def].kind == LAT_CONST)
+          {
+            int comment = instr.comment;
+            instr = ir::copy(instr.dst, ir::Operand::constant(m_values[names.def].value));
+            instr.comment = comment;
+            passes::count("sccp.folded");
+          }
+        }
+
+        auto& term = instrs.back();
+        if (term.op == ir::IR_BRANCH && m_edges.count({ id, term.target[0] }) != m_edges.count({ id, term.target[1] }))
+        {
+          int target = m_edges.count({ id, term.target[0] }) ? term.target[0] : term.target[1];
+          int comment = term.comment;
+          term = ir::jump(target);
+          term.comment = comment;
+          passes::count("sccp.branches");
+        }
+      }
+
+      auto& layout = m_func.getLayout();
+      layout.erase(std::remove_if(layout.begin(), layout.end(), [&](int id)
+      {
+        return !m_executable[id];
+      }), layout.end());
+    }
+
+    ir::Function& m_func;
+    int m_vregs;
+    std::map<int, int> m_slots; // $gp offset to its variable number
+    std::vector<int> m_idom;
+    std::vector<std::vector<int>> m_preds;
+    std::vector<std::vector<int>> m_children; // Dominator tree
+    std::vector<std::vector<int>> m_defBlocks; // Blocks defining each variable
+    std::vector<std::vector<Phi>> m_phis;
+    std::vector<std::vector<int>> m_stacks; // Current value of each variable while renaming
+    std::vector<std::vector<InstrNames>> m_names;
+    std::vector<Lattice> m_values;
+    std::vector<std::vector<int>> m_users; // Blocks reading each value
+    std::vector<bool> m_executable;
+    std::set<std::pair<int, int>> m_edges; // Executable edges
+    std::deque<int> m_work;
+  };
+}
+
+// Replaces registers and variable loads that hold the same constant on every
+// executable path with the constant, and branches whose outcome is then known
+// with jumps, dropping the blocks no executable edge reaches
+void passes::propagateConstants(ir::Function& func)
+{
+  Sccp(func).run();
+}
@@ -0,0 +1,155 @@
+// Primary Include
+#include "passes.hpp"
+
+// Project Includes
+#include "ir.hpp"
+
+// Standard Includes
+#include <algorithm>
+#include <map>
+
+namespace
+{
+  // Reorders the expression trees of one block. A tree node is a pure
+  // instruction whose result is used exactly once, later in the same block;
+  // everything else is a root and keeps its place. Each root is preceded by
+  // its tree, with the subtree that needs more registers evaluated first.
+  class Scheduler
+  {
+  public:
+    Scheduler(ir::Block& block, const std::vector<int>& uses) : m_block(block), m_uses(uses) {}
+
+    void run()
+    {
+      const auto& instrs = m_block.instrs;
+      std::map<int, int> defs;
+      for (int i = 0; i < static_cast<int>(instrs.size()); ++i)
+      {
+        for (auto&& src : instrs[i].src)
+        {
+          if (src.isReg() && defs.count(src.value) && isPure(defs[src.value]))
+          {
+            m_nodes[src.value] = defs[src.value];
+            m_users[defs[src.value]] = i;
+          }
+        }
+        if (instrs[i].dst >= 0)
+          defs[instrs[i].dst] = i;
+      }
+
+      // A node is emitted right before the root of its tree, which moves
+      // further when a user turns out to be a root after all
+      bool changed = true;
+      while (changed)
+      {
+        changed = false;
+        for (auto it = m_nodes.begin(); it != m_nodes.end();)
+        {
+          if (!canMove(it->second, getRoot(it->second)))
+          {
+            it = m_nodes.erase(it);
+            changed = true;
+          }
+          else
+            ++it;
+        }
+      }
+
+      std::vector<ir::Instr> order;
+      order.reserve(instrs.size());
+      for (int i = 0; i < static_cast<int>(instrs.size()); ++i)
+      {
+        if (instrs[i].dst < 0 || !m_nodes.count(instrs[i].dst))
+          schedule(i, order);
+      }
+      m_block.instrs = std::move(order);
+    }
+
+  private:
+    bool isPure(int def) const
+    {
+      const auto& instr = m_block.instrs[def];
+      return !ir::hasSideEffects(instr) && m_uses[instr.dst] == 1;
+    }
+
+    int getRoot(int def) const
+    {
+      int user = m_users.at(def);
+      while (m_block.instrs[user].dst >= 0 && m_nodes.count(m_block.instrs[user].dst))
+        user = m_users.at(user);
+      return user;
+    }
+
+    // Loads may not move past anything that writes memory or performs I/O,
+    // nor any node past a redefinition of one of its operands, like a loop
+    // counter update
+    bool canMove(int def, int root) const
+    {
+      const auto& instrs = m_block.instrs;
+      const auto& srcs = instrs[def].src;
+      bool load = instrs[def].op == ir::IR_LOAD;
+      return std::none_of(instrs.begin() + def + 1, instrs.begin() + root, [&](const ir::Instr& instr)
+      {
+        if (load && ir::hasSideEffects(instr))
+          return true;
+        return instr.dst >= 0 && ((srcs[0].isReg() && srcs[0].value == instr.dst) || (srcs[1].isReg() && srcs[1].value == instr.dst));
+      });
+    }
+
+    int getNode(const ir::Operand& operand) const
+    {
+      if (!operand.isReg())
+        return -1;
+      auto it = m_nodes.find(operand.value);
+      return it == m_nodes.end() ? -1 : it->second;
+    }
+
+    // Registers needed to evaluate the tree rooted at an instruction, operands already in registers need none
+    int need(int index)
+    {
+      auto it = m_need.find(index);
+      if (it != m_need.end())
+        return it->second;
+
+      int lhs = 0;
+      int rhs = 0;
+      const auto& instr = m_block.instrs[index];
+      if (getNode(instr.src[0]) >= 0)
+        lhs = need(getNode(instr.src[0]));
+      if (getNode(instr.src[1]) >= 0)
+        rhs = need(getNode(instr.src[1]));
+
+      int result = std::max({ 1, lhs, rhs, std::min(lhs, rhs) + 1 });
+      m_need[index] = result;
+      return result;
+    }
+
+    void schedule(int index, std::vector<ir::Instr>& order)
+    {
+      const auto& instr = m_block.instrs[index];
+      int lhs = getNode(instr.src[0]);
+      int rhs = getNode(instr.src[1]);
+      if (lhs >= 0 && rhs >= 0 && need(rhs) > need(lhs))
+        std::swap(lhs, rhs);
+      if (lhs >= 0)
+        schedule(lhs, order);
+      if (rhs >= 0)
+        schedule(rhs, order);
+      order.push_back(instr);
+    }
+
+    ir::Block& m_block;
+    const std::vector<int>& m_uses;
+    std::map<int, int> m_nodes; // Tree node vreg to its instruction index
+    std::map<int, int> m_users; // Tree node instruction index to the index of its user
+    std::map<int, int> m_need;
+  };
+}
+
+void passes::sethiUllman(ir::Function& func)
+{
+  auto uses = ir::countUses(func);
+
+  for (auto&& id : func.getLayout())
+    Scheduler(func.getBlock(id), uses).run();
+}
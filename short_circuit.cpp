@@ -0,0 +1,159 @@
+// Primary Include
+#include "passes.hpp"
+
+// Project Includes
+#include "ir.hpp"
+
+// Standard Includes
+#include <algorithm>
+#include <set>
+
+namespace
+{
+  // Index of the instruction in the block defining vreg before the terminator, -1 if none
+  int findDef(const std::vector<ir::Instr>& instrs, int vreg)
+  {
+    for (int i = static_cast<int>(instrs.size()) - 2; i >= 0; --i)
+    {
+      if (instrs[i].dst == vreg)
+        return i;
+    }
+    return -1;
+  }
+
+  class ShortCircuit
+  {
+  public:
+    ShortCircuit(ir::Function& func) : m_func(func), m_uses(ir::countUses(func)) {}
+
+    void run()
+    {
+      std::vector<int> work(m_func.getLayout().rbegin(), m_func.getLayout().rend());
+      while (!work.empty())
+      {
+        int id = work.back();
+        work.pop_back();
+        int split = splitBlock(id);
+        if (split >= 0)
+        {
+          work.push_back(split);
+          work.push_back(id);
+        }
+      }
+    }
+
+  private:
+    // Pure single use instructions of the block that only feed vreg, in block order
+    std::set<int> findTree(const std::vector<ir::Instr>& instrs, int vreg)
+    {
+      std::set<int> tree;
+      std::vector<int> pending = { vreg };
+      while (!pending.empty())
+      {
+        int reg = pending.back();
+        pending.pop_back();
+        int index = findDef(instrs, reg);
+        if (index < 0 || m_uses[reg] != 1 || ir::hasSideEffects(instrs[index]))
+          continue;
+        tree.insert(index);
+        for (auto&& src : instrs[index].src)
+        {
+          if (src.isReg())
+            pending.push_back(src.value);
+        }
+      }
+      return tree;
+    }
+
+    // Splits a block ending in a branch on (a & b) or (a | b) so that b is
+    // only evaluated when a does not decide the outcome, returns the new
+    // block or -1 when the block does not qualify
+    int splitBlock(int id)
+    {
+      auto& instrs = m_func.getBlock(id).instrs;
+      if (instrs.empty() || instrs.back().op != ir::IR_BRANCH)
+        return -1;
+
+      auto term = instrs.back();
+      if (term.cond != ir::COND_EQ && term.cond != ir::COND_NE)
+        return -1;
+      if (term.src[0].isConst())
+        std::swap(term.src[0], term.src[1]);
+      if (!term.src[0].isReg() || term.src[1] != ir::Operand::constant(0))
+        return -1;
+
+      // Normalize to: if value != 0 goto ifTrue else goto ifFalse
+      int ifTrue = term.target[0];
+      int ifFalse = term.target[1];
+      if (term.cond == ir::COND_EQ)
+        std::swap(ifTrue, ifFalse);
+
+      int vreg = term.src[0].value;
+      int index = findDef(instrs, vreg);
+      if (index < 0 || m_uses[vreg] != 1)
+        return -1;
+      std::set<int> removed = { index };
+
+      // A negated and/or is still a boolean, branch on it with the targets exchanged
+      if (instrs[index].op == ir::IR_XOR && instrs[index].src[1] == ir::Operand::constant(1) && instrs[index].src[0].isReg())
+      {
+        int inner = findDef(instrs, instrs[index].src[0].value);
+        if (inner < 0 || m_uses[instrs[index].src[0].value] != 1 || (instrs[inner].op != ir::IR_AND && instrs[inner].op != ir::IR_OR))
+          return -1;
+        std::swap(ifTrue, ifFalse);
+        index = inner;
+        removed.insert(index);
+      }
+
+      const auto def = instrs[index];
+      if ((def.op != ir::IR_AND && def.op != ir::IR_OR) || !def.src[0].isReg() || !def.src[1].isReg())
+        return -1;
+
+      // Everything left in the block runs before the tree of b, so loads in that tree may not move past stores or I/O
+      auto tree = findTree(instrs, def.src[1].value);
+      int first = tree.empty() ? index : *tree.begin();
+      for (int i = first; i < static_cast<int>(instrs.size()) - 1; ++i)
+      {
+        if (ir::hasSideEffects(instrs[i]))
+          return -1;
+      }
+
+      std::vector<ir::Instr> lhsInstrs;
+      std::vector<ir::Instr> rhsInstrs;
+      for (int i = 0; i < static_cast<int>(instrs.size()) - 1; ++i)
+      {
+        if (tree.count(i))
+          rhsInstrs.push_back(instrs[i]);
+        else if (!removed.count(i))
+          lhsInstrs.push_back(instrs[i]);
+      }
+
+      int rhs = m_func.addBlock();
+      rhsInstrs.push_back(ir::branch(ir::COND_NE, def.src[1], ir::Operand::constant(0), ifTrue, ifFalse));
+      rhsInstrs.back().comment = term.comment;
+      if (def.op == ir::IR_AND)
+        lhsInstrs.push_back(ir::branch(ir::COND_NE, def.src[0], ir::Operand::constant(0), rhs, ifFalse));
+      else
+        lhsInstrs.push_back(ir::branch(ir::COND_NE, def.src[0], ir::Operand::constant(0), ifTrue, rhs));
+      lhsInstrs.back().comment = term.comment;
+      m_func.getBlock(id).instrs = std::move(lhsInstrs);
+      m_func.getBlock(rhs).instrs = std::move(rhsInstrs);
+
+      auto& layout = m_func.getLayout();
+      layout.insert(std::find(layout.begin(), layout.end(), id) + 1, rhs);
+      passes::count("short-circuit");
+      return rhs;
+    }
+
+    ir::Function& m_func;
+    std::vector<int> m_uses;
+  };
+}
+
+// Branches on & and | test each operand in turn, skipping the right operand
+// when the left one already decides the branch. The front end only applies
+// & and | to booleans, so testing the operands against zero is equivalent.
+void passes::shortCircuit(ir::Function& func)
+{
+  ShortCircuit(func).run();
+}
@@ -0,0 +1,180 @@
+// Primary Include
+#include "passes.hpp"
+
+// Project Includes
+#include "ir.hpp"
+
+// Standard Includes
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace
+{
+  // Shortest chain worth replacing, shorter ones test as fast linearly
+  const int MIN_CASES = 4;
+
+  // Longest run of tests left linear at the leaves of a binary search
+  const int LINEAR_CASES = 3;
+
+  // A jump table is used when at least a third of its entries are cases
+  const int MAX_TABLE_SIZE = 1024;
+  const int MIN_TABLE_DENSITY = 3;
+
+  struct Chain
+  {
+    int value;                    // Register every test compares
+    std::map<int, int> cases;     // Constant to the block run when the value equals it
+    std::vector<int> tests;       // Blocks holding only a test, after the first
+    int otherwise;
+  };
+
+  class SwitchLowering
+  {
+  public:
+    SwitchLowering(ir::Function& func) : m_func(func), m_preds(ir::getPredecessors(func)) {}
+
+    void run()
+    {
+      auto layout = m_func.getLayout();
+      std::set<int> removed;
+      for (auto&& id : layout)
+      {
+        Chain chain;
+        if (removed.count(id) || !findChain(id, chain))
+          continue;
+
+        removed.insert(chain.tests.begin(), chain.tests.end());
+        lower(id, chain);
+      }
+
+      auto& order = m_func.getLayout();
+      order.erase(std::remove_if(order.begin(), order.end(), [&](int id)
+      {
+        return removed.count(id) > 0;
+      }), order.end());
+    }
+
+  private:
+    // Matches a branch on reg == const or reg != const, giving the equal and
+    // unequal successors
+    static bool matchTest(const ir::Instr& term, int& value, int& constant, int& equal, int& unequal)
+    {
+      if (term.op != ir::IR_BRANCH || (term.cond != ir::COND_EQ && term.cond != ir::COND_NE))
+        return false;
+
+      auto lhs = term.src[0];
+      auto rhs = term.src[1];
+      if (lhs.isConst())
+        std::swap(lhs, rhs);
+      if (!lhs.isReg() || !rhs.isConst())
+        return false;
+
+      value = lhs.value;
+      constant = rhs.value;
+      equal = term.cond == ir::COND_EQ ? term.target[0] : term.target[1];
+      unequal = term.cond == ir::COND_EQ ? term.target[1] : term.target[0];
+      return equal != unequal;
+    }
+
+    // Follows the unequal successors through blocks that only test the same
+    // register against another constant and are reached from nowhere else
+    bool findChain(int id, Chain& chain)
+    {
+      int constant, equal;
+      const auto& first = m_func.getBlock(id).instrs.back();
+      if (!matchTest(first, chain.value, constant, equal, chain.otherwise))
+        return false;
+      chain.cases[constant] = equal;
+
+      while (true)
+      {
+        const auto& instrs = m_func.getBlock(chain.otherwise).instrs;
+        int value, unequal;
+        if (instrs.size() != 1 || m_preds[chain.otherwise].size() != 1 || chain.otherwise == id)
+          break;
+        if (!matchTest(instrs.back(), value, constant, equal, unequal) || value != chain.value || chain.cases.count(constant))
+          break;
+
+        chain.cases[constant] = equal;
+        chain.tests.push_back(chain.otherwise);
+        chain.otherwise = unequal;
+      }
+      return static_cast<int>(chain.cases.size()) >= MIN_CASES;
+    }
+
+    void lower(int id, const Chain& chain)
+    {
+      auto& block = m_func.getBlock(id);
+      long long low = chain.cases.begin()->first;
+      long long size = static_cast<long long>(chain.cases.rbegin()->first) - low + 1;
+      if (size <= MAX_TABLE_SIZE && size <= MIN_TABLE_DENSITY * static_cast<long long>(chain.cases.size()))
+      {
+        block.cases.assign(static_cast<std::size_t>(size), chain.otherwise);
+        for (auto&& c : chain.cases)
+          block.cases[static_cast<std::size_t>(c.first - low)] = c.second;
+        block.instrs.back() = ir::switchOn(ir::Operand::reg(chain.value), static_cast<int>(low), chain.otherwise);
+        passes::count("switch.table");
+        return;
+      }
+
+      std::vector<std::pair<int, int>> cases(chain.cases.begin(), chain.cases.end());
+      m_insert = std::find(m_func.getLayout().begin(), m_func.getLayout().end(), id) - m_func.getLayout().begin() + 1;
+      auto term = search(chain, cases, 0, static_cast<int>(cases.size()));
+      m_func.getBlock(id).instrs.back() = term;
+      passes::count("switch.search");
+    }
+
+    // Branch deciding cases [begin, end): halves by an ordering test until
+    // only a few equality tests remain. New blocks follow the chain's first
+    // block in the layout in the order they are created.
+    ir::Instr search(const Chain& chain, const std::vector<std::pair<int, int>>& cases, int begin, int end)
+    {
+      auto value = ir::Operand::reg(chain.value);
+      if (end - begin > LINEAR_CASES)
+      {
+        int mid = begin + (end - begin) / 2;
+        int lower = newBlock();
+        int upper = newBlock();
+        // Searching adds blocks, so the function's block list may move
+        auto lowerTest = search(chain, cases, begin, mid);
+        m_func.getBlock(lower).instrs.push_back(lowerTest);
+        auto upperTest = search(chain, cases, mid, end);
+        m_func.getBlock(upper).instrs.push_back(upperTest);
+        return ir::branch(ir::COND_LT, value, ir::Operand::constant(cases[mid].first), lower, upper);
+      }
+
+      // Each test but the first gets its own block, falling to the next one
+      std::vector<int> tests(1, -1);
+      for (int i = begin + 1; i < end; ++i)
+        tests.push_back(newBlock());
+      tests.push_back(chain.otherwise);
+      for (int i = begin + 1; i < end; ++i)
+      {
+        auto test = ir::branch(ir::COND_EQ, value, ir::Operand::constant(cases[i].first), cases[i].second, tests[i - begin + 1]);
+        m_func.getBlock(tests[i - begin]).instrs.push_back(test);
+      }
+      return ir::branch(ir::COND_EQ, value, ir::Operand::constant(cases[begin].first), cases[begin].second, tests[1]);
+    }
+
+    int newBlock()
+    {
+      int id = m_func.addBlock();
+      auto& layout = m_func.getLayout();
+      layout.insert(layout.begin() + m_insert++, id);
+      return id;
+    }
+
+    ir::Function& m_func;
+    std::vector<std::vector<int>> m_preds;
+    std::ptrdiff_t m_insert = 0;
+  };
+}
+
+// Turns elseif chains comparing one register with several distinct constants
+// into an indirect jump through a table when the constants are dense and into
+// a binary search over them otherwise
+void passes::lowerSwitches(ir::Function& func)
+{
+  SwitchLowering(func).run();
+}
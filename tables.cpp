@@ -14,10 +14,12 @@ namespace
 
   std::vector<Table_t> symbolTables(1);
   std::vector<std::string> stringTable;
+  std::vector<std::vector<std::string>> jumpTables;
+
+  int gpOffset = 0;
 
   int getGpOffset(int size = 4)
   {
-    static int gpOffset = 0;
     int offset = gpOffset;
     gpOffset += size;
     return offset;
@@ -35,13 +37,11 @@ namespace
     }
   }
 
+  // Names in a procedure may hide global ones
   tables::Symbol addSymbol(const std::string& name, const tables::Symbol& symbol)
   {
-    for (auto it = symbolTables.rbegin(); it != symbolTables.rend(); ++it)
-    {
-      if (it->find(name) != it->end())
-        logger::error("Multiple definitions: Symbol '" + name + "' is already defined");
-    }
+    if (symbolTables.back().find(name) != symbolTables.back().end())
+      logger::error("Multiple definitions: Symbol '" + name + "' is already defined");
 
     symbolTables.back()[name] = symbol;
     return symbol;
@@ -72,6 +72,11 @@ tables::Symbol tables::addInteger(const std::string& name, bool isConst, int val
   return addIntSymbol(name, TYPE_INT, isConst, value);
 }
 
+tables::Symbol tables::addLocal(const std::string& name, Type type, int vreg)
+{
+  return addSymbol(name, { type, false, "local", vreg });
+}
+
 tables::Symbol tables::addString(const std::string& name, const std::string& str)
 {
   return addSymbol(name, { TYPE_STRING, true, addString(str), 0 });
@@ -84,6 +89,13 @@ std::string tables::addString(const std::string& str)
   return loc;
 }
 
+std::string tables::addJumpTable(const std::vector<std::string>& labels)
+{
+  std::string loc = "JT_" + std::to_string(jumpTables.size());
+  jumpTables.push_back(labels);
+  return loc;
+}
+
 tables::Symbol tables::getSymbol(const std::string& name)
 {
   for (auto it = symbolTables.rbegin(); it != symbolTables.rend(); ++it)
@@ -95,15 +107,47 @@ tables::Symbol tables::getSymbol(const std::string& name)
   logger::compileError("Symbol '" + name + "' was not declared");
 }
 
-//void tables::pushTable()
-//{
-//  symbolTables.push_back(Table_t());
-//}
-//
-//void tables::popTable()
-//{
-//  symbolTables.pop_back();
-//}
+void tables::pushTable()
+{
+  symbolTables.push_back(Table_t());
+}
+
+void tables::popTable()
+{
+  symbolTables.pop_back();
+}
+
+std::map<int, int> tables::packGlobals(const std::set<int>& used, const std::set<int>& read)
+{
+  // Variables by offset, which is declaration order
+  std::map<int, std::pair<std::string, tables::Symbol*>> variables;
+  for (auto&& table : symbolTables)
+  {
+    for (auto&& symbol : table)
+    {
+      if (symbol.second.location == "$gp")
+        variables[symbol.second.value] = { symbol.first, &symbol.second };
+    }
+  }
+
+  std::map<int, int> moved;
+  std::string unread;
+  gpOffset = 0;
+  for (auto&& variable : variables)
+  {
+    if (used.count(variable.first))
+    {
+      moved[variable.first] = getGpOffset();
+      variable.second.second->value = moved[variable.first];
+    }
+    if (!read.count(variable.first))
+      unread += (unread.empty() ? "'" : ", '") + variable.second.first + "'";
+  }
+
+  if (!unread.empty())
+    logger::compileWarning("Variables never read, left out of GA: " + unread);
+  return moved;
+}
 
 void tables::writeTables()
 {
@@ -119,4 +163,14 @@ void tables::writeTables()
   logger::code(".align 4", "Align on a word boundary");
   logger::label("GA");
   logger::code(".space " + std::to_string(getGpOffset(0)));
+
+  // Write jump tables, word aligned after GA
+  idx = 0;
+  for (auto&& table : jumpTables)
+  {
+    std::string words;
+    for (auto&& label : table)
+      words += (words.empty() ? "" : ", ") + label;
+    logger::label("JT_" + std::to_string(idx++), ".word " + words);
+  }
 }
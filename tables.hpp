@@ -5,7 +5,10 @@
 #include "compiler.hpp"
 
 // Standard Includes
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 namespace tables
 {
@@ -21,13 +24,22 @@ namespace tables
   Symbol addBoolean(const std::string& name, bool isConst = false, int value = 0);
   Symbol addCharacter(const std::string& name, bool isConst = false, int value = 0);
   Symbol addInteger(const std::string& name, bool isConst = false, int value = 0);
+  // Variable or value parameter of a procedure, kept in a virtual register
+  Symbol addLocal(const std::string& name, Type type, int vreg);
   Symbol addString(const std::string& name, const std::string& str);
   std::string addString(const std::string& str);
+  // Word table of code labels in the data segment, returns its label
+  std::string addJumpTable(const std::vector<std::string>& labels);
 
   Symbol getSymbol(const std::string& name);
 
-  //void pushTable();
-  //void popTable();
+  void pushTable();
+  void popTable();
+
+  // Moves the variables at the used $gp offsets next to each other and leaves
+  // the rest out of GA, with a warning for those the source never reads.
+  // Returns the new offset of each used one.
+  std::map<int, int> packGlobals(const std::set<int>& used, const std::set<int>& read);
 
   void writeTables();
 }